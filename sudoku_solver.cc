@@ -22,15 +22,102 @@
 // *Instead of recollecting the numbers within row, column and box every time a cell is considered, the numbers in use for every row, column and box are kept track of                                         //
 // *Quite a few small optimizations to preliminary calculation of offsets, loop conditions and value consideration for blank cells                                                                             //
 //                                                                                                                                                                                                             //
+// alternative engine 'bitmask' (selected with -e bitmask):                                                                                                                                                    //
+// *Every row, column and box keeps a 9-bit mask of the values still free in it (bit v set if value v is not yet used)                                                                                         //
+// *The candidates of a blank are the AND of its row, column and box masks, the next value to try is found by counting trailing zeros                                                                          //
+// *Instead of visiting the blanks in file order, the blank with the fewest candidates is filled next (most-constrained cell first)                                                                            //
+//                                                                                                                                                                                                             //
+// constraint propagation (level selected with -l, engine 'propagate' selected with -e propagate):                                                                                                             //
+// *Every cell keeps a mask of its remaining candidates, placing a value removes it from the 20 peers of the cell                                                                                              //
+// *Level 1 places naked singles (one candidate left in a cell) and hidden singles (one cell left for a value in a row, column or box)                                                                         //
+// *Level 2 additionally removes candidates by naked pairs, hidden pairs and pointing pairs                                                                                                                    //
+// *For the engines 'backtrack' and 'bitmask', the deductions run once before the search and fill every cell they decide                                                                                       //
+// *The engine 'propagate' runs them at every node of its search; the candidates are copied for every branch, backtracking merely steps back to the previous copy                                              //
+//                                                                                                                                                                                                             //
+// engine 'dlx' (selected with -e dlx):                                                                                                                                                                        //
+// *The sudoku as exact cover problem: 729 rows (cell and value) by 324 columns (cell filled, value once per row, column and box)                                                                              //
+// *Solved by Knuth's Algorithm X on Dancing Links, always branching on the column with the fewest rows left                                                                                                   //
+// *All nodes are preallocated in contiguous arrays of the solver context and link to each other by index, every search restores the matrix                                                                    //
+//                                                                                                                                                                                                             //
+// engine 'simd' (selected with -e simd):                                                                                                                                                                      //
+// *One puzzle per lane of a vector of 16-bit candidate masks (16 lanes with AVX2, 8 with SSE4.1, plain scalar code otherwise)                                                                                 //
+// *All lanes propagate naked and hidden singles in lockstep, with the same cell and peer offsets for every lane                                                                                               //
+// *Then every lane takes one step of its own search (branch on its most-constrained cell, backtrack or finish)                                                                                                //
+// *A lane that finishes its puzzle takes on the next one of the input right away, so all lanes stay busy in batch mode                                                                                        //
+//                                                                                                                                                                                                             //
+// batch mode (selected with -b):                                                                                                                                                                              //
+// *Every puzzle of the input is solved, read either in the titled block format of 'grid.dat' or as one line of 81 characters per puzzle                                                                       //
+// *All state of a search lives in a solver context instead of global variables, every worker thread owns one                                                                                                  //
+// *Chunks of puzzles are spread over a pool of worker threads that steal work from each other once their own queue is empty                                                                                   //
+// *Results are written in input order, one line of 81 digits per puzzle                                                                                                                                       //
+// *A block of the input that ends before its grid is full, or holds a damaged line (stray characters, more cells than the grid), yields an 'invalid puzzle' line,                                             //
+//  so that output line k always belongs to puzzle k of the input                                                                                                                                              //
+//                                                                                                                                                                                                             //
+// parallel search of a single puzzle (selected with -p):                                                                                                                                                      //
+// *The first blanks are branched on up front, every resulting subtree is a task for the worker pool, searched with the selected engine                                                                        //
+// *While workers are idle, a worker splits its subtree further instead of searching it, so that the idle workers can steal the parts                                                                          //
+// *A search already running hands out the untried values of its shallowest open branch as tasks whenever it finds workers idle at its periodic check of the cancel flag (every engine but 'simd')             //
+// *All workers are cancelled as soon as one of them has found a solution                                                                                                                                      //
+//                                                                                                                                                                                                             //
+// grid sizes (selected with -n):                                                                                                                                                                              //
+// *Every engine but 'simd' is a template over the box size, instantiated for grids of 4x4, 9x9, 16x16 and 25x25 cells                                                                                         //
+// *All offsets, bounds and table strides are compile-time constants of the instantiation, so the 9x9 code is the same as with literals                                                                        //
+// *Candidate masks are 16 bits wide up to 9x9 and 32 bits from 16x16 on; tables indexed by unit and value have rows padded to a multiple of 4 and start on a cache line                                       //
+// *Values above 9 are written as letters: A for 10, B for 11, up to P for 25                                                                                                                                  //
+//                                                                                                                                                                                                             //
+// solution counting (selected with -c and -a):                                                                                                                                                                //
+// *Every engine but 'simd' can go on after a solution: it resumes its usual backtracking from the solved grid instead of returning                                                                            //
+// *-c stops after the given number of solutions, so -c 2 tells a unique solution from several after at most the second one                                                                                    //
+// *-a writes every solution as one line of cells as soon as it is found, without keeping any of them                                                                                                          //
+//                                                                                                                                                                                                             //
+// generator (selected with -g):                                                                                                                                                                               //
+// *A random complete grid: a pattern grid with shuffled values, rows within bands, bands, columns within stacks and stacks, maybe transposed                                                                  //
+// *Its clues are removed in random order, every one for good unless the puzzle is left with more than one solution (checked as with -c 2)                                                                     //
+// *One task per puzzle on the worker pool; every puzzle has its own random generator seeded with the seed and its index, the output does not depend on the threads                                            //
+//                                                                                                                                                                                                             //
+// benchmark (selected with -B):                                                                                                                                                                               //
+// *Runs every engine (or the one selected with -e) single-threaded on every puzzle of the corpus 'bench.dat' (or the given file)                                                                              //
+// *Writes nodes and latency per puzzle as well as latency percentiles, puzzles/s and nodes/s per engine as JSON to stdout                                                                                     //
+//                                                                                                                                                                                                             //
 // compilation and execution:                                                                                                                                                                                  //
 // *no additional arguments necessary for compilation and execution                                                                                                                                            //
 // *input file 'grid.dat' has to be present in the same directory, with valid sudoku grid                                                                                                                      //
+// *compile with -pthread on older toolchains, as batch mode uses threads                                                                                                                                      //
+// *compile with -mavx2 or -msse4.1 (or -march=native) for the vectorized code of engine 'simd'                                                                                                                //
+// *compile with -DSUDOKU_STATS for detailed search statistics (values tried, placements, backtracks per depth) in the -s and -B output                                                                        //
+// *optional arguments: [-n 4|9|16|25] [-e backtrack|bitmask|propagate|dlx|simd] [-l 0|1|2] [-b|-p|-B|-g count] [-c limit] [-a] [-S seed] [-j threads] [-r repeats] [-t seconds] [-s] [file|-]                 //
+//  -n selects the size of the grid (default: 9), the engine 'simd' is available for 9x9 only                                                                                                                  //
+//  -e selects the search engine (default: backtrack), -s writes a JSON line with search nodes and parse/search/output times to stderr                                                                         //
+//  -l selects the level of constraint propagation (default: 0, none); engines 'propagate' and 'simd' always do singles at least                                                                               //
+//  -b solves every puzzle of the input, -p splits the search of a single puzzle over all threads                                                                                                              //
+//  -c prints the number of solutions, counted up to the limit (0: all), instead of the solution; with -b, one line per puzzle                                                                                 //
+//  -a prints every solution of the puzzle, one line each (up to the limit of -c, if given, without the count), -c and -a cannot be combined with -p or -B                                                     //
+//  -g generates the given number of puzzles with a unique solution, from the seed given with -S (default: 1), checked with engine 'bitmask' (16x16 and up: 'propagate') unless selected with -e               //
+//  -j sets the number of worker threads for -b, -p and -g (default: one per core)                                                                                                                             //
+//  -B runs the benchmark, -r sets the runs per puzzle (the fastest counts), -t the seconds after which a puzzle is given up (default: 10)                                                                     //
+//  file replaces the default input file 'grid.dat' ('bench.dat' for -B), '-' reads from stdin                                                                                                                 //
 // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // // //
 
 
 
 #include <iostream>                                       //iostream for output
 #include <fstream>                                        //fstream to read input file
+#include <string>                                         //string for command line arguments and input lines
+#include <vector>                                         //vector for batches of puzzles and per-worker contexts
+#include <deque>                                          //deque for the task queues of the worker pool
+#include <functional>                                     //function to hold the tasks of the worker pool
+#include <thread>                                         //thread, mutex, condition_variable and atomic for the worker pool
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>                                         //chrono for timing of the search
+#include <algorithm>                                      //sort for the latency percentiles of the benchmark
+#include <cstdlib>                                        //atoi for command line arguments
+#include <type_traits>                                    //conditional for the mask and offset types of the grid sizes
+#include <random>                                         //mt19937_64 for the grids and clue orders of the generator
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>                                    //immintrin for the vector tests of the SIMD engine
+#endif
 
 using namespace std;                                      //standard namespace
 typedef char num;                                         //define new type 'num' as type char for 1 byte-sized unsigned 'integers', new name to avoid confusion with 'real' characters
@@ -38,83 +125,340 @@ typedef char num;                                         //define new type 'num
 
 
 // ==============================================================================================================================================================================================================
-// GLOBAL VARIABLES
+// GEOMETRY
 // ==============================================================================================================================================================================================================
 
-num sudoku_grid[81];                                      //array of size 81 to hold all grid information in one-dimensional array, split into usual 9x9 grid via offset=9*row+column
-num * sudoku = sudoku_grid;                               //pointer pointing to the memory of sudoku_grid
-num * rel_sudoku = sudoku_grid;                           //pointer pointing to the memory of the current position in sudoku_grid
+// Dimensions of a sudoku with boxes of BxB cells: B*B values, rows, columns and boxes, and (B*B)^2 cells. Every engine is a template
+// over B, so that all bounds, offsets and strides of an instantiation are compile-time constants, exactly like the literals of the
+// original 9x9 code (B=3).
+template<int B> struct geometry{
+  static constexpr int box = B;                           //rows and columns of a box
+  static constexpr int size = B*B;                        //values, and cells of every row, column and box
+  static constexpr int cells = size*size;                 //cells of the grid
+  static constexpr int units = 3*size;                    //rows, columns and boxes
+  static constexpr int peers = 3*size - 2*B - 1;          //cells sharing a row, column or box with a cell (20 for 9x9)
+  static constexpr int stride = (size+1+3) & ~3;          //row length of the tables indexed by unit and value (0 to size), padded to a multiple of 4 (12 for 9x9)
+  typedef typename conditional<size+1<=16, unsigned short, unsigned int>::type mask;         //candidate mask: bit v set if value v is available, bit 0 unused so that the bit index equals the value
+  typedef typename conditional<cells<=255, unsigned char, unsigned short>::type cell_index;  //offset of a cell, or a number of cells
+  static constexpr mask all_values = (mask) (((1u << size) - 1) << 1);  //bits 1 to size set: every value is still available
+};
+
+const int max_box = 5;                                    //largest box size instantiated, grids of 4x4, 9x9, 16x16 and 25x25 are supported
+
+
+
+// ==============================================================================================================================================================================================================
+// EXACT COVER MATRIX
+// ==============================================================================================================================================================================================================
+
+// The sudoku as the standard exact cover problem: 729 rows (one per cell and value) and 324 columns (every cell filled once, every value once
+// in every row, column and box) for 9x9, with the 4 ones of every row as nodes of the circular doubly linked lists of Dancing Links.
+// All nodes live in preallocated arrays and link to each other by index, nothing is allocated while solving.
+template<int B> struct dancing_links{
+  typedef geometry<B> G;
+  static const int n_columns = 4*G::cells;                //cells, row-values, column-values, box-values (324 for 9x9)
+  static const int n_rows = G::cells*G::size;             //cells times values (729 for 9x9)
+  static const int root = 0;                              //header of the list of uncovered columns
+  static const int first_node = n_columns + 1;            //nodes 1 to n_columns are the column headers, the 4 nodes of matrix row r start at first_node+4*r
+  static const int n_nodes = first_node + 4*n_rows;
+  static_assert(n_nodes <= 65536, "node indices have to fit into 16 bits");  //65001 nodes for 25x25
+
+  unsigned short left[n_nodes], right[n_nodes];           //horizontal links: uncovered columns for headers, the other nodes of the same row for nodes
+  unsigned short up[n_nodes], down[n_nodes];              //vertical links: the other nodes of the same column
+  unsigned short column[n_nodes];                         //column header of every node
+  unsigned short size[n_columns+1];                       //number of nodes left in every column
+  bool built;                                             //whether the links are set up already; every search leaves the matrix as it found it
+
+  dancing_links() : built(false) {}
+
+  // Sets up the full matrix. Called once, before the first search on this context.
+  void build(){
+    for(int c=0;c<=n_columns;c++){                        //all columns empty and linked into the header list
+      left[c] = c ? c-1 : n_columns;
+      right[c] = c<n_columns ? c+1 : root;
+      up[c] = down[c] = column[c] = c;
+      size[c] = 0;
+    }
+    for(int r=0;r<n_rows;r++){
+      int cell = r/G::size, v = r%G::size, row = cell/G::size, col = cell%G::size, box = (row/B)*B + col/B;
+      int columns[4] = {1 + cell, 1 + G::cells + row*G::size + v, 1 + 2*G::cells + col*G::size + v, 1 + 3*G::cells + box*G::size + v};
+      for(int k=0;k<4;k++){
+        int n = first_node + 4*r + k, c = columns[k];
+        left[n] = k ? n-1 : n+3;
+        right[n] = k<3 ? n+1 : n-3;
+        column[n] = c;
+        up[n] = up[c];                                    //append at the bottom of the column
+        down[n] = c;
+        down[up[c]] = n;
+        up[c] = n;
+        size[c]++;
+      }
+    }
+    built = true;
+  }
+
+  // Removes a column from the header list and all rows with a node in it from the other columns.
+  void cover(int c){
+    right[left[c]] = right[c];
+    left[right[c]] = left[c];
+    for(int i=down[c];i!=c;i=down[i]){
+      for(int j=right[i];j!=i;j=right[j]){
+        down[up[j]] = down[j];
+        up[down[j]] = up[j];
+        size[column[j]]--;
+      }
+    }
+  }
+
+  // Exact reverse of cover(), in reverse order.
+  void uncover(int c){
+    for(int i=up[c];i!=c;i=up[i]){
+      for(int j=left[i];j!=i;j=left[j]){
+        size[column[j]]++;
+        down[up[j]] = j;
+        up[down[j]] = j;
+      }
+    }
+    right[left[c]] = c;
+    left[right[c]] = c;
+  }
 
-unsigned short int empty_cells[81];                       //array of size 81 to hold all offsets for the empty cells of the sudoku grid; 2D with offset=9*row+column
-unsigned short int * empty = empty_cells;                 //pointer pointing to the memory of empty_cells
-unsigned short int * rel_empty = empty_cells;             //pointer pointing to the memory of the current position in empty_cells
+  // Covers the columns of all nodes of a row except the given one (whose column is covered already).
+  void select(int n){
+    for(int j=right[n];j!=n;j=right[j]) cover(column[j]);
+  }
 
-num value = 0;                                            //will give the value to be evaluated at the current position within the sudoku
+  // Exact reverse of select().
+  void deselect(int n){
+    for(int j=left[n];j!=n;j=left[j]) uncover(column[j]);
+  }
 
-unsigned short int cols_grid[81];                         //array of size 81 to hold the column of every blank cell; 2D with offset=9*row+column
-unsigned short int * cols = cols_grid;                    //pointer pointing to the memory of cols_grid
-unsigned short int * rel_cols = cols_grid;                //pointer pointing to the memory of the current blank in cols_grid
-unsigned short int rows_grid[81];                         //array of size 81 to hold the row multiple (that is 9*row) of every blank cell; 2D with offset=9*row+column
-unsigned short int * rows = rows_grid;                    //pointer pointing to the memory of rows_grid
-unsigned short int * rel_rows = rows_grid;                //pointer pointing to the memory of the current blank in rows_grid
-unsigned short int boxes_grid[81];                        //array of size 81 to hold the box of every blank cell; 2D with offset=9*row+column
-unsigned short int * boxes = boxes_grid;                  //pointer pointing to the memory of boxes_grid
-unsigned short int * rel_boxes = boxes_grid;              //pointer pointing to the memory of the current blank in boxes_grid
+  // Whether a column is still in the header list.
+  bool uncovered(int c) const { return right[left[c]]==c; }
 
-bool used_values_col[120];                                 //array of size 120 to hold usage info for every number for every column (if in use=0, 1 otherwise); 2D with offset=12*column+number
-bool * used_col = used_values_col;                         //pointer pointing to the memory of used_values_col
-bool * used_rel_col = used_values_col;                     //pointer pointing to the memory of the current column and value in used_values_col
-bool used_values_row[120];                                 //array of size 120 to hold usage info for every number for every row (if in use=0, 1 otherwise); 2D with offset=12*row+number
-bool * used_row = used_values_row;                         //pointer pointing to the memory of used_values_row
-bool * used_rel_row = used_values_row;                     //pointer pointing to the memory of the current row and value in used_values_row
-bool used_values_box[120];                                 //array of size 120 to hold usage info for every number for every box (if in use=0, 1 otherwise); 2D with offset=12*box+number
-bool * used_box = used_values_box;                         //pointer pointing to the memory of used_values_box
-bool * used_rel_box = used_values_box;                     //pointer pointing to the memory of the current box and value in used_values_box
+  // Matrix row of a node, that is size*cell + value-1.
+  static int row_of(int n){ return (n - first_node) >> 2; }
+};
 
 
 
 // ==============================================================================================================================================================================================================
-// MAIN
+// SOLVER CONTEXT
+// ==============================================================================================================================================================================================================
+
+// Detailed search statistics, only compiled in with -DSUDOKU_STATS. Without it, STATS(...) expands to nothing and the search loops
+// are exactly the same as without any instrumentation.
+#ifdef SUDOKU_STATS
+#define STATS(statement) statement
+#else
+#define STATS(statement)
+#endif
+
+#ifdef SUDOKU_STATS
+struct search_stats{                                      //counters of the searches on one context
+  unsigned long long tried;                               //values tried (value++ iterations of the backtracker, candidates or rows tried by the other engines)
+  unsigned long long placements;                          //values placed into a blank
+  unsigned long long backtracks;                          //steps back to the previous blank (iterations of the unwind loop of the backtracker)
+  unsigned max_depth;                                     //most blanks filled at the same time
+  unsigned long long backtrack_depth[geometry<max_box>::cells+1];  //backtracks by the number of blanks filled when they happened, for the largest grid size
+
+  search_stats(){ clear(); }
+
+  void clear(){
+    tried = placements = backtracks = 0;
+    max_depth = 0;
+    for(int d=0;d<=geometry<max_box>::cells;d++) backtrack_depth[d] = 0;
+  }
+
+  void add(const search_stats & other){
+    tried += other.tried;
+    placements += other.placements;
+    backtracks += other.backtracks;
+    max_depth = max(max_depth, other.max_depth);
+    for(int d=0;d<=geometry<max_box>::cells;d++) backtrack_depth[d] += other.backtrack_depth[d];
+  }
+
+  void placed(unsigned depth){
+    placements++;
+    if(depth>max_depth) max_depth = depth;
+  }
+
+  void backtracked(unsigned depth){
+    backtracks++;
+    backtrack_depth[depth]++;
+  }
+};
+
+// Writes the counters as further members of a JSON object.
+void write_stats(ostream & out, const search_stats & stats){
+  out << ", \"tried\": " << stats.tried << ", \"placements\": " << stats.placements << ", \"backtracks\": " << stats.backtracks
+      << ", \"max_depth\": " << stats.max_depth << ", \"backtrack_depth\": [";
+  for(unsigned d=0;d<=stats.max_depth;d++) out << (d ? ", " : "") << stats.backtrack_depth[d];
+  out << ']';
+}
+#endif
+
+template<int B> struct work_sharing{                      //hand-out of untried branches of a running search to idle workers (parallel search)
+  function<bool()> wanted;                                //whether other workers are waiting for work
+  function<void(const num *)> give;                       //queues the grid of a branch, which its giver no longer searches itself
+};
+
+struct lockstep_buffers{                                  //saved branches of the SIMD engine, kept from search to search of a context
+  vector<unsigned short> saved;                           //candidates of all cells for every lane and depth, allocated by the first search
+  vector<unsigned char> branch;                           //cell branched on for every lane and depth
+};
+
+// All state of one search. Every worker thread owns one, so that several puzzles can be solved at the same time.
+// The tables indexed by unit and value have rows of G::stride entries (12 for 9x9) and start on a cache line of their own.
+template<int B> struct solver_context{
+  typedef geometry<B> G;
+  unsigned short int empty_cells[G::cells+1];             //array to hold all offsets for the empty cells of the sudoku grid plus the sentinel; 2D with offset=size*row+column
+  unsigned short int cols_grid[G::cells];                 //array to hold the column multiple (that is stride*column) of every blank cell
+  unsigned short int rows_grid[G::cells];                 //array to hold the row multiple (that is stride*row) of every blank cell
+  unsigned short int boxes_grid[G::cells];                //array to hold the box multiple (that is stride*box) of every blank cell
+  alignas(64) bool used_values_col[G::stride*G::size];    //array to hold usage info for every number for every column (if in use=0, 1 otherwise); 2D with offset=stride*column+number
+  alignas(64) bool used_values_row[G::stride*G::size];    //array to hold usage info for every number for every row (if in use=0, 1 otherwise); 2D with offset=stride*row+number
+  alignas(64) bool used_values_box[G::stride*G::size];    //array to hold usage info for every number for every box (if in use=0, 1 otherwise); 2D with offset=stride*box+number
+  unsigned long long nodes;                               //number of search nodes (=placements of a value into a blank), for comparison of the engines
+  const atomic<bool> * cancel;                            //if set, the search gives up (returns false) soon after this flag turns true
+  int propagation;                                        //level of the deductions before and during the search: 0 none, 1 singles, 2 singles and pairs
+  unsigned long long solution_limit;                      //solutions after which a search stops: 1 to solve, 2 to check uniqueness, 0 for all
+  unsigned long long solutions;                           //solutions found by the last search
+  const function<void(const num *)> * on_solution;        //if set, called with the grid of every solution found
+  const work_sharing<B> * sharing;                        //if set, asked along with the cancel flag whether to hand out untried branches
+  dancing_links<B> dlx;                                   //exact cover matrix of the dancing links engine
+  lockstep_buffers lockstep;                              //saved branches of the SIMD engine (9x9 only, empty otherwise)
+#ifdef SUDOKU_STATS
+  search_stats stats;                                     //detailed statistics of all searches on this context
+#endif
+
+  solver_context() : nodes(0), cancel(0), propagation(0), solution_limit(1), solutions(0), on_solution(0), sharing(0) {}
+};
+
+template<int B> using engine_function = bool (*)(solver_context<B> &, num *);  //every engine solves a grid in place and returns false if there is no solution
+
+template<int B> struct puzzle;
+
+template<int B> struct engine_entry{                      //an engine as selected on the command line
+  const char * name;
+  engine_function<B> solve;
+  bool propagates;                                        //whether the engine propagates by itself, making the pre-pass redundant
+  void (*solve_range)(solver_context<B> &, puzzle<B> *, char *, size_t);  //solves a whole range of puzzles at once (SIMD engine), 0 if the engine only takes one at a time
+  bool counts;                                            //whether the engine can go on after a solution, as needed to count or enumerate them
+};
+
+const unsigned long long cancel_interval = 4095;          //the cancel flag is looked at every 4096 nodes, often enough to stop within microseconds without slowing the search
+
+// Whether a search running on this context is to give up. Only called every cancel_interval+1 nodes, by the SIMD engine every round.
+template<int B> inline bool cancelled(const solver_context<B> & ctx){
+  return ctx.cancel && ctx.cancel->load(memory_order_relaxed);
+}
+
+// Records a solution that a search has just completed in the grid. Returns true if the search is to stop, that is once the
+// context's limit is reached; otherwise the search resumes from the solution and leaves the grid in an unspecified state.
+template<int B> inline bool solution_found(solver_context<B> & ctx, const num * grid){
+  ctx.solutions++;
+  if(ctx.on_solution) (*ctx.on_solution)(grid);
+  return ctx.solutions==ctx.solution_limit;               //never true for the limit 0, which asks for all solutions
+}
+
+// Whether a search running on this context is to hand out its untried branches now. Only called every cancel_interval+1 nodes.
+template<int B> inline bool sharing_wanted(const solver_context<B> & ctx){
+  return ctx.sharing && ctx.sharing->wanted();
+}
+
+// Values not yet used in the row, column and box of a cell of the grid.
+template<int B> typename geometry<B>::mask free_values(const num * grid, int cell){
+  typedef geometry<B> G;
+  int row = cell/G::size, col = cell%G::size, box = (row/B)*B*G::size + (col/B)*B;  //row, column and offset of the top left cell of the box
+  typename G::mask used = 0;
+  for(int k=0;k<G::size;k++) used |= 1 << grid[row*G::size+k] | 1 << grid[k*G::size+col] | 1 << grid[box+(k/B)*G::size+k%B];
+  return G::all_values & ~used;                           //bit 0 collects the blanks
+}
+
+// Hands out one branch per value of the mask: the grid, which holds every cell decided before the branch, with the value in the cell.
+// The cell is blank again afterwards.
+template<int B> void share_values(const solver_context<B> & ctx, num * grid, int cell, typename geometry<B>::mask values){
+  for(;values;values&=values-1){
+    grid[cell] = __builtin_ctz(values);
+    ctx.sharing->give(grid);
+  }
+  grid[cell] = 0;
+}
+
+
+
+// ==============================================================================================================================================================================================================
+// BACKTRACK ENGINE
 // ==============================================================================================================================================================================================================
 
-int main(){
+// Hands out the values above the current one of the first blank from 'floor' on that has any left, for the backtracker with the blanks
+// empty[0..depth-1] filled. Returns the new floor, the blank after that one, or the old floor if no blank had values left.
+template<int B> int share_blanks(const solver_context<B> & ctx, const num * sudoku, const unsigned short int * empty, int floor, int depth){
+  typedef geometry<B> G;
+  num work[G::cells];                                     //the grid with only the blanks before the one handed out filled
+  copy(sudoku, sudoku+G::cells, work);
+  for(int k=floor;k<depth;k++) work[empty[k]] = 0;
+  for(int k=floor;k<depth;k++){
+    int cell = empty[k];
+    typename G::mask untried = free_values<B>(work, cell) & ~((2 << sudoku[cell]) - 1);  //values are tried in increasing order
+    if(untried){
+      share_values(ctx, work, cell, untried);
+      return k+1;
+    }
+    work[cell] = sudoku[cell];
+  }
+  return floor;
+}
+
+// Solves the given grid in place. Returns false if the givens contradict each other or the grid has no solution.
+template<int B> bool solve_backtrack(solver_context<B> & ctx, num * sudoku){
+  typedef geometry<B> G;                                  //for 9x9: 81 cells, 9 values, stride 12
+  unsigned short int * empty = ctx.empty_cells;           //pointer pointing to the memory of empty_cells; the search ends when unwinding reaches it, so it moves past blanks whose other values were handed out
+  unsigned short int * rel_empty = empty;                 //pointer pointing to the memory of the current position in empty_cells
+  unsigned short int * cols = ctx.cols_grid;              //pointer pointing to the memory of cols_grid
+  unsigned short int * rel_cols = cols;                   //pointer pointing to the memory of the current blank in cols_grid
+  unsigned short int * rows = ctx.rows_grid;              //pointer pointing to the memory of rows_grid
+  unsigned short int * rel_rows = rows;                   //pointer pointing to the memory of the current blank in rows_grid
+  unsigned short int * boxes = ctx.boxes_grid;            //pointer pointing to the memory of boxes_grid
+  unsigned short int * rel_boxes = boxes;                 //pointer pointing to the memory of the current blank in boxes_grid
+  bool * used_col = ctx.used_values_col;                  //pointer pointing to the memory of used_values_col
+  bool * used_row = ctx.used_values_row;                  //pointer pointing to the memory of used_values_row
+  bool * used_box = ctx.used_values_box;                  //pointer pointing to the memory of used_values_box
+  num * rel_sudoku = sudoku;                              //pointer pointing to the memory of the current position in the grid
+  num value = 0;                                          //will give the value to be evaluated at the current position within the sudoku
+  num past_end;                                           //stands in for the cell of the sentinel when the search resumes after a solution
 
   //preliminary operations
-  for(num l=0;l<120;l++){                                 //set every element of the used arrays to true to indicate that no numbers are in use yet
+  ctx.solutions = 0;
+  for(int l=0;l<G::stride*G::size;l++){                   //set every element of the used arrays to true to indicate that no numbers are in use yet
     *(used_col+l) = true;                                 //
     *(used_row+l) = true;                                 //
     *(used_box+l) = true;                                 //
   }                                                       //
 
+  //input evaluation
+  unsigned short int insert_i = 0;
+  while(insert_i!=G::cells){                              //go through all elements of the sudoku
+    unsigned short int col = (insert_i%G::size)*G::stride;  //calculate column multiple (stride*column) by modulo of current offset with 9, gives offset to previous multiple of 9 = column
+    unsigned short int row = ((insert_i - col/G::stride)/G::size)*G::stride;  //calcualte row multiple (stride*row) by truncating current offset after division by number of columns p
+    unsigned short int box = ((row/(B*G::stride))*B + (col/(B*G::stride)))*G::stride;  //calculate box multiple (stride*box) by truncating (row/3) and (column/3) (36 for 9x9 since col and row are gives as multiples of 12 and 3*12=36)
 
-  ifstream data;                                          //with fstream
-  data.open("grid.dat");                                  //open the input file 'grid.dat' in the same directory
-
-  //input loop
-  num insert_i = 0;                                       
-  while(insert_i!=81){                                    //go through all 81 elements of the sudoku
-    data >> *rel_sudoku;                                  //insert current element into array position pointed to by rel_sudoku
-    *rel_sudoku = *rel_sudoku - '0';                      //inserted 'number' is considered a 'character', subtract '0'==48 to obtain 'correct' ie. integer value
-    unsigned short int col = (insert_i%9)*12;             //calculate column multiple (12*column) by modulo of current offset with 9, gives offset to previous multiple of 9 = column
-    unsigned short int row = ((insert_i - col/12)/9)*12;  //calcualte row multiple (12*row) by truncating current offset after division by number of columns p
-    unsigned short int box = ((row/36)*3 + (col/36))*12;  //calculate box multiple (12*box) by truncating (row/3) and (column/3) (36 in code since col and row are gives as multiples of 12 and 3*12=36)
-
-    //input evaluation
-    if(*rel_sudoku){                                      //if inserted cell is not to be filled, ie. contains a number as sudoku constraint:
+    if(*rel_sudoku){                                      //if the cell is not to be filled, ie. contains a number as sudoku constraint:
+      if(!(*(used_col+col+*rel_sudoku) && *(used_row+row+*rel_sudoku) && *(used_box+box+*rel_sudoku))) return false;  //the same number is given twice within a row, column or box
       *(used_col+col+*rel_sudoku) = false;                //save this number as a number that is already in use within the current column
       *(used_row+row+*rel_sudoku) = false;                //same for row
       *(used_box+box+*rel_sudoku) = false;                //same for box
-    } else {                                              //if inserted cell is to be filled:
+    } else {                                              //if the cell is to be filled:
       *(rel_empty++) = insert_i;                          //save position in array empty_cells pointed to by rel_empty; increment rel_empty for next iteration
       *(rel_cols++) = col;                                //save column multiple so it does not have to be recalculated if this blank cell is considered, increment for next iteration
       *(rel_rows++) = row;                                //same for row multiple
       *(rel_boxes++) = box;                               //same for box multiple
     }
-    rel_sudoku++;                                         //for the next iteration, the next cell is to be filled
+    rel_sudoku++;                                         //for the next iteration, the next cell is to be evaluated
     insert_i++;                                           //next cell offset is to be considered
   }
-  *rel_empty = 81;                                        //the element after the last saved position of array empty_cells is set to 81 (invalid value) to act as sentinel
-  data.close();                                           //close input file
+  *rel_empty = G::cells;                                  //the element after the last saved position of array empty_cells is set to 81 (invalid value) to act as sentinel
 
   //reset of pointers
   rel_empty = empty;                                      //reset relative position of pointer rel_empty to beginning of array empty_cells
@@ -122,19 +466,30 @@ int main(){
   rel_rows = rows;                                        //same for rel_rows
   rel_boxes = boxes;                                      //same for rel_boxes
   rel_sudoku = sudoku + *rel_empty;                       //relative position of rel_sudoku is set to the first blank by offsetting pointer sudoku by the position of the first blank saved in *rel_empty
- 
-  //loop over blanks
-  while(*rel_empty!=81){                                  //as long as the sentinel of empty_cells (==81) is not yet reached, indicating there are empty cells left to fill
-    used_rel_row = used_row+*rel_rows;                    //update relative pointer to used numbers in row to current cell's row multiple
-    used_rel_col = used_col+*rel_cols;                    //same for column
-    used_rel_box = used_box+*rel_boxes;                   //same for box
+  bool * used_rel_row;                                    //pointer pointing to the memory of the current row and value in used_values_row
+  bool * used_rel_col;                                    //pointer pointing to the memory of the current column and value in used_values_col
+  bool * used_rel_box;                                    //pointer pointing to the memory of the current box and value in used_values_box
 
-    //evaluation loop
+  //loop over blanks
+  for(;;){
     bool valid;                                           //stores the result of duplicate comparison, false if duplicate is present, true otherwise
-    do{
-      value++;                                            //increment value for evaluation (at first iteration from blank==0 to 1)
-      valid = *(used_rel_row+value) && *(used_rel_col+value) && *(used_rel_box+value);  //check for duplicates by checking if the respective position within used has been set to 1
-    } while(!valid && value!=9);                          //as long as there is a duplicate of the same value within row/column/box and the value is < 9
+    if(*rel_empty!=G::cells){                             //as long as the sentinel of empty_cells (==81) is not yet reached, indicating there are empty cells left to fill
+      used_rel_row = used_row+*rel_rows;                  //update relative pointer to used numbers in row to current cell's row multiple
+      used_rel_col = used_col+*rel_cols;                  //same for column
+      used_rel_box = used_box+*rel_boxes;                 //same for box
+
+      //evaluation loop
+      do{
+        value++;                                          //increment value for evaluation (at first iteration from blank==0 to 1)
+        STATS(ctx.stats.tried++;)
+        valid = *(used_rel_row+value) & *(used_rel_col+value) & *(used_rel_box+value);  //check for duplicates by checking if the respective position within used has been set to 1; '&' instead of '&&' saves two hard-to-predict branches
+      } while(!valid && value!=G::size);                  //as long as there is a duplicate of the same value within row/column/box and the value is < 9
+    } else {                                              //the last blank was filled successfully: a solution
+      if(solution_found(ctx, sudoku)) return true;        //enough solutions (the first one, unless counting)
+      valid = false;                                      //otherwise the search goes on as if the sentinel had run out of values,
+      value = G::size;                                    //so that the unwinding below resumes at the last blank
+      rel_sudoku = &past_end;
+    }
 
     //updating of pointers and collections
     if(valid){                                            //if the dowhile-loop terminated due to finding no duplicate -> valid=true
@@ -148,9 +503,17 @@ int main(){
       rel_boxes++;                                        //same for box
       rel_sudoku = sudoku + *rel_empty;                   //update rel_sudoku accordingly
       value = 0;                                          //value is set to the value of the next blank (ie. 0)
+      ctx.nodes++;                                        //one more search node (=placement) for the statistics
+      STATS(ctx.stats.placed(rel_empty - ctx.empty_cells);)
+      if(!(ctx.nodes & cancel_interval)){
+        if(cancelled(ctx)) return false;                  //another worker already found the solution
+        if(sharing_wanted(ctx)) empty = ctx.empty_cells + share_blanks(ctx, sudoku, ctx.empty_cells, empty-ctx.empty_cells, rel_empty-ctx.empty_cells);  //other workers are idle: the search ends at the blank after the one whose values were handed out
+      }
     } else {                                              //if there is no duplicate in row, column and box
-      while(value==9){                                    //as long as the previous cells to be filled are at max value
+      while(value==G::size){                              //as long as the previous cells to be filled are at max value
 	*rel_sudoku = 0;                                  //reset current cell back to a blank since assumed solution is invalid
+	if(rel_empty==empty) return ctx.solutions!=0;     //every number failed for the first blank as well: there is no (further) solution
+	STATS(ctx.stats.backtracked(rel_empty - ctx.empty_cells);)
 	rel_empty--;                                      //go back to the previous cell which was already considered and incorrectly filled
 	rel_cols--;                                       //update relative pointer to column 
 	rel_rows--;                                       //same for row
@@ -163,85 +526,1704 @@ int main(){
       }
     }
   }
+}
 
-  //Output of solution
-  for(num i=0;i<81;i++){                                  //for all 81 elements of the sudoku
-    if(!(i%9)) cout << '\n';                              //insert a new line if new row is reached
-    cout << (int) *(sudoku+i);                            //print value of sudoku_grid at position pointed to by (sudoku+i)
+
+
+// ==============================================================================================================================================================================================================
+// BITMASK ENGINE
+// ==============================================================================================================================================================================================================
+
+template<int B> struct blank_cell{                        //position of a blank within the grid, kept together so the most-constrained blank can be swapped to the front in one go
+  typename geometry<B>::cell_index cell;                  //offset into the grid
+  unsigned char row, col, box;                            //row, column and box index (0-8 for 9x9, no multiples needed as masks are looked up directly)
+};
+
+// Solves the given grid in place. Returns false if the givens contradict each other or the grid has no solution.
+// The masks are 16 bits wide up to 9x9 and 32 bits from 16x16 on (see geometry).
+template<int B> bool solve_bitmask(solver_context<B> & ctx, num * grid){
+  typedef geometry<B> G;
+  typedef typename G::mask mask;
+  typedef typename G::cell_index cell_index;
+  mask free_row[G::size], free_col[G::size], free_box[G::size];  //values still free in every row, column and box
+  blank_cell<B> blanks[G::cells];                         //every blank of the grid; blanks[0..depth-1] are filled in the order they were chosen
+  mask candidates[G::cells+1];                            //values not yet tried for the blank at every depth, none at the depth of a solution
+
+  ctx.solutions = 0;
+  for(int l=0;l<G::size;l++){                             //at first, every value is free everywhere
+    free_row[l] = G::all_values;
+    free_col[l] = G::all_values;
+    free_box[l] = G::all_values;
+  }
+
+  //gather givens and blanks
+  cell_index n_blanks = 0;                                //number of blanks, the search is finished once depth reaches it
+  for(cell_index i=0;i<G::cells;i++){                     //go through all elements of the sudoku
+    unsigned char row = i/G::size, col = i%G::size, box = (row/B)*B + col/B;
+    if(grid[i]){                                          //a given: its value is no longer free in its row, column and box
+      mask bit = 1 << grid[i];
+      if(!(free_row[row] & free_col[col] & free_box[box] & bit)) return false;  //the same given appears twice in a row, column or box
+      free_row[row] &= ~bit;
+      free_col[col] &= ~bit;
+      free_box[box] &= ~bit;
+    } else {                                              //a blank: remember its position
+      blank_cell<B> & blank = blanks[n_blanks++];
+      blank.cell = i; blank.row = row; blank.col = col; blank.box = box;
+    }
+  }
+
+  //search loop
+  cell_index depth = 0;                                   //number of blanks filled so far
+  for(;;){
+    if(depth!=n_blanks){                                  //as long as there are blanks left to fill
+
+      //choice of the most-constrained blank among the ones not filled yet
+      cell_index best = depth;                            //index of the blank with the fewest candidates
+      mask best_mask = 0;                                 //candidates of that blank
+      int best_count = G::size+1;                         //number of candidates of that blank, size+1 is more than any blank can have
+      for(cell_index k=depth;k!=n_blanks;k++){
+        mask m = free_row[blanks[k].row] & free_col[blanks[k].col] & free_box[blanks[k].box];
+        int count = __builtin_popcount(m);
+        if(count < best_count){
+          best = k; best_mask = m; best_count = count;
+          if(count <= 1) break;                           //no blank can be better than a forced one (or one without candidates, which fails right away)
+        }
+      }
+      blank_cell<B> chosen = blanks[best];                //swap the chosen blank to the current depth
+      blanks[best] = blanks[depth];
+      blanks[depth] = chosen;
+      candidates[depth] = best_mask;
+    } else {                                              //every blank is filled: a solution
+      if(solution_found(ctx, grid)) return true;          //enough solutions (the first one, unless counting)
+      candidates[depth] = 0;                              //otherwise back to the last blank and on with its next candidate
+    }
+
+    //backtracking as long as the current blank has no untried candidates left
+    while(!candidates[depth]){
+      if(!depth) return ctx.solutions!=0;                 //every possibility of the first blank failed: there is no (further) solution
+      STATS(ctx.stats.backtracked(depth);)
+      depth--;                                            //go back to the previous blank and undo its value
+      const blank_cell<B> & prev = blanks[depth];
+      mask bit = 1 << grid[prev.cell];
+      free_row[prev.row] |= bit;
+      free_col[prev.col] |= bit;
+      free_box[prev.box] |= bit;
+      grid[prev.cell] = 0;
+    }
+
+    //placement of the smallest untried candidate
+    const blank_cell<B> & cur = blanks[depth];
+    mask cand = candidates[depth];
+    num v = __builtin_ctz(cand);                          //index of the lowest set bit = smallest candidate value
+    candidates[depth] = cand & (cand - 1);                //this value is tried now, remove it from the untried candidates
+    mask bit = 1 << v;
+    free_row[cur.row] &= ~bit;                            //the value is now in use in this blank's row, column and box
+    free_col[cur.col] &= ~bit;
+    free_box[cur.box] &= ~bit;
+    grid[cur.cell] = v;
+    depth++;                                              //the next blank is to be chosen
+    ctx.nodes++;                                          //one more search node (=placement) for the statistics
+    STATS(ctx.stats.tried++; ctx.stats.placed(depth);)    //only candidates are tried, so every value tried is placed
+    if(!(ctx.nodes & cancel_interval)){
+      if(cancelled(ctx)) return false;                    //another worker already found the solution
+      if(sharing_wanted(ctx)){                            //other workers are idle: hand out the untried candidates of the first blank that has any
+        cell_index d = 0;
+        while(d!=depth && !candidates[d]) d++;
+        if(d!=depth){
+          num work[G::cells];                             //the grid with only the blanks before that one filled
+          copy(grid, grid+G::cells, work);
+          for(cell_index k=d;k!=depth;k++) work[blanks[k].cell] = 0;
+          share_values(ctx, work, blanks[d].cell, candidates[d]);
+          candidates[d] = 0;
+        }
+      }
+    }
+  }
+}
+
+
+
+// ==============================================================================================================================================================================================================
+// PROPAGATION
+// ==============================================================================================================================================================================================================
+
+// Cell offsets of every row (units 0-8 for 9x9), column (9-17) and box (18-26), as well as the 20 peers of every cell (cells sharing
+// a row, column or box with it). Calculated once at startup for every grid size.
+template<int B> struct unit_tables{
+  typedef geometry<B> G;
+  typedef typename G::cell_index cell_index;
+  alignas(64) cell_index cells[G::units][G::size];        //cells of every unit
+  alignas(64) cell_index peers[G::cells][G::peers];       //peers of every cell
+  static const unit_tables all;                           //the tables of this grid size
+
+  unit_tables(){
+    for(int i=0;i<G::cells;i++){
+      int row = i/G::size, col = i%G::size, box = (row/B)*B + col/B, in_box = (row%B)*B + col%B;
+      cells[row][col] = i;
+      cells[G::size+col][row] = i;
+      cells[2*G::size+box][in_box] = i;
+    }
+    for(int i=0;i<G::cells;i++){
+      int n = 0;
+      for(int j=0;j<G::cells;j++){
+        bool same_row = i/G::size==j/G::size, same_col = i%G::size==j%G::size;
+        bool same_box = (i/(B*G::size)==j/(B*G::size)) && (i%G::size/B==j%G::size/B);
+        if(i!=j && (same_row || same_col || same_box)) peers[i][n++] = j;
+      }
+    }
+  }
+};
+template<int B> const unit_tables<B> unit_tables<B>::all;
+
+template<int B> struct candidate_grid{                    //state of the propagation, copied at every branch of the search so that backtracking is a mere step back
+  typename geometry<B>::mask cells[geometry<B>::cells];   //values still possible in every cell, a single bit once the cell is decided
+  num values[geometry<B>::cells];                         //value of every decided cell, 0 while it is open
+  typename geometry<B>::cell_index n_open;                //number of cells not decided yet
+};
+
+template<int B> struct single_queue{                      //cells left with a single candidate that are not placed yet; every cell is queued at most once
+  typename geometry<B>::cell_index cells[geometry<B>::cells];
+  typename geometry<B>::cell_index n;
+  single_queue() : n(0) {}
+};
+
+// Removes a value from the candidates of a cell. Returns false if no candidate is left.
+template<int B> inline bool eliminate(candidate_grid<B> & g, int cell, typename geometry<B>::mask bit, single_queue<B> & singles){
+  typename geometry<B>::mask m = g.cells[cell];
+  if(!(m & bit)) return true;                             //not a candidate anyway
+  m &= ~bit;
+  g.cells[cell] = m;
+  if(!(m & (m-1))){                                       //no candidate left, or a single one to be placed (naked single)
+    if(!m) return false;
+    singles.cells[singles.n++] = cell;
+  }
+  return true;
+}
+
+// Decides a cell and removes its value from all peers. Returns false if the value is not possible there or a peer runs out of candidates.
+template<int B> inline bool place(candidate_grid<B> & g, int cell, typename geometry<B>::mask bit, single_queue<B> & singles){
+  if(!(g.cells[cell] & bit)) return false;
+  g.cells[cell] = bit;
+  g.values[cell] = __builtin_ctz(bit);
+  g.n_open--;
+  const typename geometry<B>::cell_index * peer = unit_tables<B>::all.peers[cell];
+  for(int p=0;p<geometry<B>::peers;p++) if(!eliminate(g, peer[p], bit, singles)) return false;
+  return true;
+}
+
+// Naked and hidden pairs within every unit, pointing pairs within every box (level 2).
+// Returns -1 on a contradiction, 1 if any candidate was removed, 0 otherwise.
+template<int B> int reduce_pairs(candidate_grid<B> & g, single_queue<B> & singles){
+  typedef geometry<B> G;
+  typedef typename G::mask mask;                          //also holds one bit per cell of a unit
+  const unit_tables<B> & units = unit_tables<B>::all;
+  bool changed = false;
+  for(int u=0;u<G::units;u++){
+    const typename G::cell_index * cell = units.cells[u];
+
+    //naked pairs: two cells with the same two candidates, which are therefore taken from every other cell of the unit
+    for(int i=0;i<G::size;i++){
+      mask pair = g.cells[cell[i]];
+      if(g.values[cell[i]] || __builtin_popcount(pair)!=2) continue;
+      for(int j=i+1;j<G::size;j++){
+        if(g.cells[cell[j]]!=pair) continue;
+        for(int k=0;k<G::size;k++){
+          if(k==i || k==j || !(g.cells[cell[k]] & pair)) continue;
+          if(!eliminate(g, cell[k], pair & -pair, singles) || !eliminate(g, cell[k], pair & (pair-1), singles)) return -1;
+          changed = true;
+        }
+      }
+    }
+
+    //hidden pairs: two values possible in the same two cells only, which therefore lose every other candidate
+    mask where[G::size+1] = {0};                          //for every value, bit k set if it is possible in the k-th cell of the unit
+    for(int k=0;k<G::size;k++){
+      if(g.values[cell[k]]) continue;
+      for(mask m=g.cells[cell[k]];m;m&=m-1) where[__builtin_ctz(m)] |= 1u << k;
+    }
+    for(int v=1;v<=G::size;v++){
+      if(__builtin_popcount(where[v])!=2) continue;
+      for(int w=v+1;w<=G::size;w++){
+        if(where[w]!=where[v]) continue;
+        mask pair = (1u << v) | (1u << w);
+        for(mask k=where[v];k;k&=k-1){
+          int c = cell[__builtin_ctz(k)];
+          if(g.cells[c]!=pair){
+            g.cells[c] = pair;
+            changed = true;
+          }
+        }
+      }
+    }
+
+    //pointing pairs: a value possible only within one row or column of a box is taken from the rest of that row or column
+    if(u<2*G::size) continue;                             //boxes only
+    for(int v=1;v<=G::size;v++){
+      if(where[v]<2 || !(where[v] & (where[v]-1))) continue;  //decided, or a single cell, which is left to the hidden singles
+      int first = __builtin_ctz(where[v]);
+      bool one_row = true, one_col = true;
+      for(mask k=where[v];k;k&=k-1){
+        one_row = one_row && __builtin_ctz(k)/B==first/B;
+        one_col = one_col && __builtin_ctz(k)%B==first%B;
+      }
+      if(!one_row && !one_col) continue;
+      int line = one_row ? cell[first]/G::size : G::size + cell[first]%G::size;
+      for(int k=0;k<G::size;k++){
+        int c = units.cells[line][k];
+        if(g.values[c] || !(g.cells[c] & (1u << v))) continue;
+        if(c/(B*G::size)==cell[0]/(B*G::size) && c%G::size/B==cell[0]%G::size/B) continue;  //inside the box itself
+        if(!eliminate(g, c, 1u << v, singles)) return -1;
+        changed = true;
+      }
+    }
+  }
+  return changed;
+}
+
+// Applies the deductions of the given level until none of them makes any progress: naked and hidden singles (level 1),
+// additionally naked, hidden and pointing pairs (level 2). Returns false if the grid turns out to have no solution.
+template<int B> bool propagate(candidate_grid<B> & g, int level, single_queue<B> & singles){
+  typedef geometry<B> G;
+  typedef typename G::mask mask;
+  for(;;){
+    //naked singles
+    while(singles.n){
+      int c = singles.cells[--singles.n];
+      if(!g.values[c] && !place(g, c, g.cells[c], singles)) return false;
+    }
+    if(!g.n_open) return true;                            //everything decided
+
+    //hidden singles: a value possible in only one cell of a unit
+    bool changed = false;
+    for(int u=0;u<G::units;u++){
+      const typename G::cell_index * cell = unit_tables<B>::all.cells[u];
+      mask once = 0, twice = 0;                           //values possible in at least one and at least two cells of the unit
+      for(int k=0;k<G::size;k++){
+        mask m = g.cells[cell[k]];
+        twice |= once & m;
+        once |= m;
+      }
+      if(once!=G::all_values) return false;               //some value has no place left in this unit
+      mask hidden = once & ~twice;
+      if(!hidden) continue;
+      for(int k=0;k<G::size;k++){
+        if(g.values[cell[k]]) continue;
+        mask m = g.cells[cell[k]] & hidden;
+        if(!m) continue;
+        if(m & (m-1)) return false;                       //a cell that would have to hold two values at once
+        if(!place(g, cell[k], m, singles)) return false;
+        changed = true;
+      }
+    }
+    if(changed || singles.n) continue;
+
+    if(level<2) return true;
+    int pairs = reduce_pairs(g, singles);
+    if(pairs<0) return false;
+    if(!pairs) return true;                               //no progress anymore
+  }
+}
+
+// Sets up the candidates for the givens of a grid and propagates them. Returns false if the grid turns out to have no solution.
+template<int B> bool load(candidate_grid<B> & g, const num * grid, int level){
+  typedef geometry<B> G;
+  single_queue<B> singles;
+  for(int c=0;c<G::cells;c++){
+    g.cells[c] = G::all_values;
+    g.values[c] = 0;
+  }
+  g.n_open = G::cells;
+  for(int c=0;c<G::cells;c++) if(grid[c] && !g.values[c] && !place(g, c, 1u << grid[c], singles)) return false;
+  return propagate(g, level, singles);
+}
+
+// Pre-pass for the engines without propagation of their own: fills every cell the deductions of the context's level decide.
+// Does nothing at level 0. Returns false if the grid turns out to have no solution.
+template<int B> bool presolve(solver_context<B> & ctx, num * grid){
+  if(!ctx.propagation) return true;
+  candidate_grid<B> g;
+  if(!load(g, grid, ctx.propagation)) return false;
+  copy(g.values, g.values+geometry<B>::cells, grid);
+  return true;
+}
+
+// Search that propagates at every node (engine 'propagate'). Branches on the open cell with the fewest candidates; the candidate grid
+// is copied for every branch, so that backtracking only has to step back to the copy of the previous depth.
+template<int B> bool solve_propagate(solver_context<B> & ctx, num * grid){
+  typedef geometry<B> G;
+  typedef typename G::mask mask;
+  int level = ctx.propagation ? ctx.propagation : 1;      //singles at least, without them this would only be a slower bitmask engine
+  candidate_grid<B> stack[G::cells+1];                    //candidate grid at every depth
+  typename G::cell_index branch_cell[G::cells];           //cell branched on at every depth
+  mask untried[G::cells];                                 //values not yet tried for that cell
+
+  ctx.solutions = 0;
+  if(!load(stack[0], grid, level)) return false;
+  int depth = 0;
+  for(;;){
+    const candidate_grid<B> & g = stack[depth];
+    if(!g.n_open){                                        //solved
+      copy(g.values, g.values+G::cells, grid);
+      if(solution_found(ctx, grid) || !depth) return true;  //enough solutions, or the deductions decided everything without a branch
+      STATS(ctx.stats.backtracked(depth);)                //otherwise on with the next value of the last branch
+      depth--;
+    } else {
+      //choice of the most-constrained open cell
+      int best = -1, best_count = G::size+1;
+      for(int c=0;c<G::cells;c++){
+        if(g.values[c]) continue;
+        int count = __builtin_popcount(g.cells[c]);
+        if(count<best_count){
+          best = c; best_count = count;
+          if(count==2) break;                             //open cells have two candidates at least
+        }
+      }
+      branch_cell[depth] = best;
+      untried[depth] = g.cells[best];
+    }
+
+    //descent into the next branch that survives propagation, backtracking whenever a cell has no untried values left
+    for(;;){
+      while(!untried[depth]){
+        if(!depth) return ctx.solutions!=0;
+        STATS(ctx.stats.backtracked(depth);)
+        depth--;
+      }
+      mask bit = untried[depth] & -untried[depth];        //smallest untried value
+      untried[depth] &= ~bit;
+      candidate_grid<B> & next = stack[depth+1];
+      next = stack[depth];
+      ctx.nodes++;                                        //one more search node (=placement) for the statistics
+      STATS(ctx.stats.tried++;)
+      if(!(ctx.nodes & cancel_interval)){
+        if(cancelled(ctx)) return false;                  //another worker already found the solution
+        if(sharing_wanted(ctx)){                          //other workers are idle: hand out the untried values of the first branch that has any
+          int d = 0;
+          while(d<=depth && !untried[d]) d++;
+          if(d<=depth){
+            num work[G::cells];                           //the values decided before that branch
+            copy(stack[d].values, stack[d].values+G::cells, work);
+            share_values(ctx, work, branch_cell[d], untried[d]);
+            untried[d] = 0;
+          }
+        }
+      }
+      single_queue<B> singles;
+      if(place(next, branch_cell[depth], bit, singles) && propagate(next, level, singles)){
+        depth++;
+        STATS(ctx.stats.placed(depth);)                   //a value that survives propagation counts as placed
+        break;
+      }
+    }
+  }
+}
+
+// Solves a grid with the given engine, preceded by the propagation pre-pass unless the engine propagates by itself.
+template<int B> bool solve_puzzle(const engine_entry<B> & engine, solver_context<B> & ctx, num * grid){
+  return (engine.propagates || presolve(ctx, grid)) && engine.solve(ctx, grid);
+}
+
+
+
+// ==============================================================================================================================================================================================================
+// DANCING LINKS ENGINE
+// ==============================================================================================================================================================================================================
+
+// Takes back the first n of the given rows in reverse order. Once done for the rows of the search and those of the givens,
+// the matrix is as it was before the search.
+template<int B> void restore(dancing_links<B> & m, const unsigned short * rows, int n){
+  while(n--){
+    m.deselect(rows[n]);
+    m.uncover(m.column[rows[n]]);
+  }
+}
+
+// Hands out the rows not tried yet of the first column from depth 'floor' on that has any left, for the dancing links engine with
+// the rows chosen[0..depth-1] selected. Every such row is a branch of its own, as exactly one row of the column is part of any
+// solution. Returns the new floor, the depth after that column, or the old floor if no column had rows left.
+template<int B> int share_rows(const solver_context<B> & ctx, const unsigned short * givens, int n_givens, const unsigned short * chosen, int floor, int depth){
+  typedef geometry<B> G;
+  typedef dancing_links<B> matrix;
+  const matrix & m = ctx.dlx;
+  num work[G::cells] = {0};                               //the givens and the rows chosen before that column
+  for(int k=0;k<n_givens;k++){
+    int r = matrix::row_of(givens[k]);
+    work[r/G::size] = r%G::size + 1;
+  }
+  for(int d=0;d<depth;d++){
+    int n = m.down[chosen[d]];                            //next row of the column after the chosen one
+    if(d>=floor && n!=m.column[n]){
+      for(;n!=m.column[n];n=m.down[n]){
+        int r = matrix::row_of(n);
+        work[r/G::size] = r%G::size + 1;
+        ctx.sharing->give(work);
+        work[r/G::size] = 0;
+      }
+      return d+1;
+    }
+    int r = matrix::row_of(chosen[d]);
+    work[r/G::size] = r%G::size + 1;
+  }
+  return floor;
+}
+
+// Solves the given grid in place with Algorithm X on the exact cover matrix of the context (engine 'dlx'). Always branches on
+// the column with the fewest rows left. Returns false if the givens contradict each other or the grid has no solution.
+template<int B> bool solve_dlx(solver_context<B> & ctx, num * grid){
+  typedef geometry<B> G;
+  typedef dancing_links<B> matrix;
+  matrix & m = ctx.dlx;
+  if(!m.built) m.build();
+  unsigned short givens[G::cells];                        //first node (the cell column's) of the row of every given
+  unsigned short chosen[G::cells];                        //node of the row currently tried at every depth
+  int n_givens = 0;
+  int floor = 0;                                          //first depth whose column is still searched here, the other rows of the columns before it were handed out
+  ctx.solutions = 0;
+
+  //givens: their rows are part of every solution
+  for(int cell=0;cell<G::cells;cell++){
+    if(!grid[cell]) continue;
+    int n = matrix::first_node + 4*(cell*G::size + grid[cell]-1);
+    for(int k=0;k<4;k++){                                 //a given whose constraints are met already contradicts an earlier given
+      if(!m.uncovered(m.column[n+k])){
+        restore(m, givens, n_givens);
+        return false;
+      }
+    }
+    m.cover(m.column[n]);
+    m.select(n);
+    givens[n_givens++] = n;
+  }
+
+  //search loop
+  int depth = 0;                                          //number of rows chosen so far
+  for(;;){
+    int n;                                                //row to try next
+    if(m.right[matrix::root]==matrix::root){              //every column is covered: solved
+      for(int d=0;d<depth;d++){                           //output of the chosen rows into the grid
+        int r = matrix::row_of(chosen[d]);
+        grid[r/G::size] = r%G::size + 1;
+      }
+      if(solution_found(ctx, grid) || depth==floor) break;  //enough solutions, or nothing was left to choose
+      STATS(ctx.stats.backtracked(depth);)                //otherwise on with the next row of the last column
+      depth--;
+      m.deselect(chosen[depth]);
+      n = m.down[chosen[depth]];
+    } else {
+      //choice of the column with the fewest rows left
+      int c = m.right[matrix::root], best = c;
+      for(;c!=matrix::root;c=m.right[c]){
+        if(m.size[c]<m.size[best]){
+          best = c;
+          if(m.size[c]<=1) break;                         //no column can be better than a forced one
+        }
+      }
+      m.cover(best);
+      n = m.down[best];                                   //first row of the column
+    }
+
+    //backtracking as long as the current column has no rows left to try
+    while(n==m.column[n]){                                //back at the column header
+      m.uncover(m.column[n]);
+      if(depth==floor){                                   //every row of the first column failed: there is no (further) solution
+        restore(m, chosen, depth);
+        restore(m, givens, n_givens);
+        return ctx.solutions!=0;
+      }
+      STATS(ctx.stats.backtracked(depth);)
+      depth--;                                            //take back the row of the previous depth and move on to the next row of its column
+      m.deselect(chosen[depth]);
+      n = m.down[chosen[depth]];
+    }
+
+    //choice of the row
+    chosen[depth++] = n;
+    m.select(n);
+    ctx.nodes++;                                          //one more search node (=placement) for the statistics
+    STATS(ctx.stats.tried++; ctx.stats.placed(depth);)    //every row tried is placed
+    if(!(ctx.nodes & cancel_interval)){
+      if(cancelled(ctx)){                                 //another worker already found the solution
+        restore(m, chosen, depth);
+        restore(m, givens, n_givens);
+        return false;
+      }
+      if(sharing_wanted(ctx)) floor = share_rows(ctx, givens, n_givens, chosen, floor, depth);  //other workers are idle
+    }
+  }
+
+  restore(m, chosen, depth);
+  restore(m, givens, n_givens);
+  return true;
+}
+
+
+
+// ==============================================================================================================================================================================================================
+// INPUT
+// ==============================================================================================================================================================================================================
+
+template<int B> struct puzzle{                            //one sudoku as read from the input
+  string title;                                           //title given by a preceding '#title' line, empty if there was none
+  num grid[geometry<B>::cells];                           //all cells, 0 for a blank
+  bool complete;                                          //false for a block that ended before all its cells were read
+  unsigned long line;                                     //input line of the first cells of the puzzle, for diagnostics
+};
+
+// Value of a cell character: digits 1-9, then letters A, B, ... for 10, 11, ... (up to 'P' for 25x25); 0 for '0' and '.' (blanks).
+// Returns -1 for every other character, as well as for values beyond the grid size, so that text lines are not taken for cells.
+template<int B> int cell_value(char ch){
+  int v = ch>='0' && ch<='9' ? ch - '0' : ch>='A' && ch<='Z' ? ch - 'A' + 10 : ch=='.' ? 0 : -1;
+  return v<=geometry<B>::size ? v : -1;
+}
+
+// Character of a cell value, the reverse of cell_value().
+inline char cell_char(int v){
+  return v<10 ? '0' + v : 'A' + v - 10;
+}
+
+// Reads puzzles from a stream. Accepts both the titled block format of 'grid.dat' (a '#title' line followed by 9 lines of 9 digits
+// for 9x9) and one puzzle per line (81 characters for 9x9); '0' and '.' denote blanks. Any other line (free text, separators, empty
+// lines) is skipped. A block that ends before the grid is full, be it at such a line, a title or the end of the input, is returned
+// all the same, marked incomplete, so that batch output stays aligned with the input. A line of cells that would take a block past
+// the grid ends it as well and is read again as the start of the next puzzle; if that does not lead to a complete puzzle either, its
+// cells are taken for the rest of the incomplete block returned already. A damaged line of cells, with more cells than the grid or
+// with stray characters among them (at most one per row of cells, more make it free text), belongs to a puzzle all the same: that
+// puzzle is returned incomplete rather than skipped, so that one corrupt line does not shift the output of all puzzles after it.
+template<int B> class puzzle_reader{
+public:
+  explicit puzzle_reader(istream & in) : in(in), line_number(0), reread(false), overflowed(false) {}
+
+  // Reads the next puzzle, complete or not. Returns false once the stream holds no further puzzle.
+  bool read(puzzle<B> & p){
+    typedef geometry<B> G;
+    int n_cells = 0;                                      //number of cells of the current puzzle read so far
+    bool damaged = false;                                 //whether a damaged line of cells went into the current puzzle
+    bool continuing = overflowed;                         //whether the first line is the one that overflowed the block returned last
+    overflowed = false;
+    p.title.clear();
+    for(;;){
+      if(reread) reread = false;                          //the line that ended the previous block
+      else if(getline(in, line)) line_number++;
+      else break;                                         //end of input
+      num row[G::cells];                                  //cells of this line, as far as they fit into a grid
+      int n_row = 0, n_stray = 0;                         //number of cells and of other characters (but whitespace) of the line
+      for(string::size_type c=0;c<line.size();c++){
+        char ch = line[c];
+        int v = cell_value<B>(ch);
+        if(v>=0){
+          if(n_row<G::cells) row[n_row] = v;
+          n_row++;
+        }
+        else if(ch!=' ' && ch!='\t' && ch!='\r') n_stray++;
+      }
+      bool cells_line = n_row && line[0]!='#' && n_stray*G::size<=n_row;  //cells only, or mostly: at most one stray character per row of cells
+      bool damaged_line = cells_line && (n_stray || n_row>G::cells);
+      if(n_cells && (!cells_line || n_cells+n_row>G::cells)){  //the block ends before the grid is full, the line is read again for what follows
+        reread = true;
+        if(!continuing){
+          overflowed = cells_line;
+          return incomplete(p, n_cells);
+        }
+        n_cells = 0;                                      //the rest of a block returned already: dropped without a further result
+        damaged = false;
+        continuing = cells_line;
+        continue;
+      }
+      if(!cells_line){                                    //not part of a puzzle
+        if(!line.empty() && line[0]=='#') p.title = line.substr(1);  //title line, belongs to the following puzzle
+        continuing = false;
+        continue;
+      }
+      if(!n_cells) p.line = line_number;
+      for(int c=0;c<n_row && n_cells<G::cells;c++) p.grid[n_cells++] = row[c];
+      damaged = damaged || damaged_line;
+      if(n_cells==G::cells){                              //puzzle complete
+        if(damaged) return incomplete(p, n_cells);        //but not to be trusted
+        p.complete = true;
+        return true;
+      }
+    }
+    return n_cells && !continuing && incomplete(p, n_cells);
+  }
+
+private:
+  istream & in;
+  string line;                                            //current input line
+  unsigned long line_number;                              //number of the current input line, counted from 1
+  bool reread;                                            //whether the current line is to be read again, as it ended the previous block
+  bool overflowed;                                        //whether that line is a line of cells that did not fit into the previous block
+
+  // Returns the block read so far as incomplete puzzle, its missing cells blank.
+  bool incomplete(puzzle<B> & p, int n_cells){
+    fill(p.grid+n_cells, p.grid+geometry<B>::cells, 0);
+    p.complete = false;
+    return true;
+  }
+};
+
+
+
+// ==============================================================================================================================================================================================================
+// SIMD ENGINE
+// ==============================================================================================================================================================================================================
+
+// One puzzle per lane of a vector of 16-bit candidate masks: 16 lanes with AVX2, 8 with SSE4.1. Without either, the same vector
+// code is compiled by GCC/Clang into plain scalar operations (or whatever the target offers), so the engine works everywhere.
+// The 16-bit lanes hold the candidates of 9x9 grids, the engine exists for that size only.
+typedef geometry<3> simd_geometry;
+#if defined(__AVX2__)
+const int simd_lanes = 16;
+#elif defined(__SSE4_1__)
+const int simd_lanes = 8;
+#else
+const int simd_lanes = 8;                                 //scalar fallback
+#endif
+typedef unsigned short lane_mask __attribute__((vector_size(2*simd_lanes)));  //candidate mask of the same cell in every lane, or a lane flag (0xFFFF for true, 0 for false)
+
+// Whether any lane is nonzero.
+inline bool any_lane(lane_mask v){
+#if defined(__AVX2__)
+  __m256i x = (__m256i) v;
+  return !_mm256_testz_si256(x, x);
+#elif defined(__SSE4_1__)
+  __m128i x = (__m128i) v;
+  return !_mm_testz_si128(x, x);
+#else
+  for(int l=0;l<simd_lanes;l++) if(v[l]) return true;
+  return false;
+#endif
+}
+
+// The same value in every lane.
+inline lane_mask lane_broadcast(unsigned short x){
+  lane_mask v = {};
+  return v + x;
+}
+
+// Number of set bits in every lane.
+inline lane_mask lane_popcount(lane_mask x){
+  x = x - ((x >> 1) & 0x5555);
+  x = (x & 0x3333) + ((x >> 2) & 0x3333);
+  x = (x + (x >> 4)) & 0x0F0F;
+  return (x + (x >> 8)) & 0x001F;
+}
+
+// Per lane: a where the flag is set, b otherwise.
+inline lane_mask lane_select(lane_mask flag, lane_mask a, lane_mask b){
+  return (a & flag) | (b & ~flag);
+}
+
+// Flag of the lanes where the cell holds exactly one candidate.
+inline lane_mask lane_single(lane_mask m){
+  lane_mask zero = {};
+  return (lane_mask)((m & (m-1)) == zero) & (lane_mask)(m != zero);
+}
+
+// Search of up to simd_lanes puzzles in lockstep. In every round, all lanes propagate naked and hidden singles to a fixed point
+// together, then every lane takes one step of its own search: it branches on its most-constrained cell, backtracks, or reports its
+// puzzle as finished and takes on the next puzzle of the input. The candidate state of every branch is saved per lane, in buffers
+// of the solver context, as allocating and clearing them anew took longer than many an easy puzzle.
+class lockstep_search{
+public:
+  explicit lockstep_search(lockstep_buffers & buffers){
+    buffers.saved.resize(simd_lanes*81*81);               //no-op but for the first search on the context
+    buffers.branch.resize(simd_lanes*81);
+    saved = &buffers.saved[0];
+    branch = &buffers.branch[0];
+  }
+
+  // Solves the n puzzles in place; solved[i] tells whether puzzle i has a solution.
+  void run(solver_context<3> & ctx, puzzle<3> * puzzles, char * solved, size_t n){
+    size_t next = 0;                                      //next puzzle of the input to take on
+    int active = 0;                                       //lanes working on a puzzle
+    for(int l=0;l<simd_lanes;l++){
+      if(next<n){
+        load(l, puzzles[next].grid, next);
+        next++;
+        active++;
+      } else idle(l);
+    }
+
+    while(active){
+      if(cancelled(ctx)) return;                          //another worker already found the solution (parallel search) or the benchmark gave up; every round, as nodes grow by up to one per lane
+      lane_mask bad = propagate();                        //lanes whose current branch has no solution
+
+      //most-constrained open cell of every lane
+      lane_mask best_count = lane_broadcast(16);          //more than any cell can have: no open cell
+      lane_mask best_cell = {};
+      for(int c=0;c<81;c++){
+        lane_mask count = lane_popcount(cells[c]);
+        lane_mask better = (lane_mask)(count > 1) & (lane_mask)(count < best_count);
+        best_count = lane_select(better, count, best_count);
+        best_cell = lane_select(better, lane_broadcast(c), best_cell);
+      }
+
+      //one step of every lane
+      for(int l=0;l<simd_lanes;l++){
+        if(lane_puzzle[l]<0) continue;                    //idle lane
+        bool finished = false;
+        if(bad[l]){                                       //backtrack
+          if(!depth[l]){                                  //every branch of the first cell failed: there is no solution
+            solved[lane_puzzle[l]] = false;
+            finished = true;
+          } else {
+            STATS(ctx.stats.backtracked(depth[l]);)
+            restore(l);
+          }
+        } else if(best_count[l]==16){                     //no open cell left: solved
+          num * grid = puzzles[lane_puzzle[l]].grid;
+          for(int c=0;c<81;c++) grid[c] = __builtin_ctz(cells[c][l]);
+          solved[lane_puzzle[l]] = true;
+          finished = true;
+        } else {                                          //branch on the smallest candidate of the most-constrained cell
+          guess(l, best_cell[l]);
+          ctx.nodes++;                                    //one more search node (=placement) for the statistics
+          STATS(ctx.stats.tried++; ctx.stats.placed(depth[l]);)  //every guess is placed, the propagation of the next round decides whether it holds
+        }
+        if(!finished) continue;
+        if(next<n){                                       //refill the lane with the next puzzle
+          load(l, puzzles[next].grid, next);
+          next++;
+        } else {
+          idle(l);
+          active--;
+        }
+      }
+    }
+  }
+
+private:
+  typedef simd_geometry::mask mask;
+  lane_mask cells[81];                                    //candidates of every cell in every lane
+  lane_mask done[81];                                     //lanes where the single candidate of the cell has been removed from its peers already
+  long lane_puzzle[simd_lanes];                           //puzzle of every lane, -1 while the lane is idle
+  int depth[simd_lanes];                                  //number of saved branches of every lane
+  unsigned short * saved;                                 //candidates of all cells for every lane and depth, to continue with once a branch fails
+  unsigned char * branch;                                 //cell branched on for every lane and depth
+
+  // Takes on a puzzle in a lane.
+  void load(int l, const num * grid, size_t index){
+    for(int c=0;c<81;c++){
+      cells[c][l] = grid[c] ? 1 << grid[c] : simd_geometry::all_values;
+      done[c][l] = 0;
+    }
+    lane_puzzle[l] = index;
+    depth[l] = 0;
+  }
+
+  // Fills an idle lane with a solved grid that needs no further work.
+  void idle(int l){
+    for(int c=0;c<81;c++){
+      int row = c/9, col = c%9;
+      cells[c][l] = 1 << (((row%3)*3 + row/3 + col) % 9 + 1);
+      done[c][l] = 0xFFFF;
+    }
+    lane_puzzle[l] = -1;
+  }
+
+  // Saves the state of a lane without the smallest candidate of the cell, then tries that candidate.
+  void guess(int l, int cell){
+    mask m = cells[cell][l];
+    mask bit = m & -m;
+    unsigned short * save = &saved[(l*81 + depth[l])*81];
+    for(int c=0;c<81;c++) save[c] = cells[c][l];
+    save[cell] = m & ~bit;
+    branch[l*81 + depth[l]] = cell;
+    depth[l]++;
+    cells[cell][l] = bit;
+  }
+
+  // Continues a lane with the state saved last, its cell branched on missing the candidate that just failed.
+  void restore(int l){
+    depth[l]--;
+    const unsigned short * save = &saved[(l*81 + depth[l])*81];
+    int cell = branch[l*81 + depth[l]];
+    for(int c=0;c<81;c++){
+      mask m = save[c];
+      cells[c][l] = m;
+      done[c][l] = c!=cell && !(m & (m-1)) ? 0xFFFF : 0;  //every other single was propagated before the state was saved
+    }
   }
-  cout << '\n';
 
-  return 0;                                               //obligatory return statement of main()
+  // Naked and hidden singles in all lanes until no lane makes any progress. Returns the flags of the lanes that ran into a contradiction.
+  lane_mask propagate(){
+    lane_mask bad = {};
+    bool changed = true;
+    while(changed){
+      changed = false;
+
+      //naked singles: removal of the value of every new single from its peers
+      for(int c=0;c<81;c++){
+        lane_mask fresh = lane_single(cells[c]) & ~done[c];
+        if(!any_lane(fresh)) continue;
+        done[c] |= fresh;
+        lane_mask keep = ~(cells[c] & fresh);
+        const unsigned char * peer = unit_tables<3>::all.peers[c];
+        for(int p=0;p<20;p++) cells[peer[p]] &= keep;
+        changed = true;
+      }
+
+      //hidden singles: a value possible in only one cell of a unit
+      for(int u=0;u<27;u++){
+        const unsigned char * cell = unit_tables<3>::all.cells[u];
+        lane_mask once = {}, twice = {};                  //values possible in at least one and at least two cells of the unit
+        for(int k=0;k<9;k++){
+          twice |= once & cells[cell[k]];
+          once |= cells[cell[k]];
+        }
+        bad |= (lane_mask)(once != simd_geometry::all_values);  //some value has no place left in this unit
+        lane_mask hidden = once & ~twice;
+        if(!any_lane(hidden)) continue;
+        for(int k=0;k<9;k++){
+          lane_mask m = cells[cell[k]], h = m & hidden;
+          lane_mask zero = {};
+          bad |= (lane_mask)((h & (h-1)) != zero);        //a cell that would have to hold two values at once
+          lane_mask update = (lane_mask)(h != zero) & (lane_mask)(h != m);
+          if(!any_lane(update)) continue;
+          cells[cell[k]] = lane_select(update, h, m);
+          changed = true;
+        }
+      }
+    }
+    lane_mask zero = {};
+    for(int c=0;c<81;c++) bad |= (lane_mask)(cells[c] == zero);
+    return bad;
+  }
+};
+
+// Solves a range of puzzles with the SIMD engine, refilling lanes from the range as they finish.
+void solve_simd(solver_context<3> & ctx, puzzle<3> * puzzles, char * solved, size_t n){
+  lockstep_search search(ctx.lockstep);
+  search.run(ctx, puzzles, solved, n);
 }
 
+// The SIMD engine on a single grid, for the modes working on one puzzle at a time (only one lane is busy then).
+bool solve_simd_grid(solver_context<3> & ctx, num * grid){
+  puzzle<3> p;
+  copy(grid, grid+81, p.grid);
+  char solved = false;
+  solve_simd(ctx, &p, &solved, 1);
+  if(solved) copy(p.grid, p.grid+81, grid);
+  return solved;
+}
+
+// Adds the SIMD engine to the engines of a grid size, which is a no-op but for 9x9.
+template<int B> void add_simd_engine(vector<engine_entry<B> > &){}
+inline void add_simd_engine(vector<engine_entry<3> > & engines){
+  engine_entry<3> simd = {"simd", solve_simd_grid, true, solve_simd, false};
+  engines.push_back(simd);
+}
+
+
+
+// ==============================================================================================================================================================================================================
+// WORKER POOL
+// ==============================================================================================================================================================================================================
+
+// Fixed set of worker threads with one task queue each. A worker takes tasks from the back of its own queue and, once that
+// is empty, steals from the front of the other queues, so that no core idles while work is left anywhere.
+class worker_pool{
+public:
+  typedef function<void(unsigned)> task;                  //a task receives the index of the worker running it, to use that worker's solver context
+
+  explicit worker_pool(unsigned n_workers) : queues(n_workers), queued(0), pending(0), sleeping(0), next(0), stopping(false){
+    for(unsigned w=0;w<n_workers;w++) workers.push_back(thread(&worker_pool::run, this, w));
+  }
+
+  ~worker_pool(){
+    {
+      lock_guard<mutex> guard(idle_lock);
+      stopping = true;
+    }
+    wake.notify_all();
+    for(unsigned w=0;w<workers.size();w++) workers[w].join();
+  }
+
+  unsigned size() const { return workers.size(); }
+
+  // Number of workers currently sleeping for lack of tasks.
+  unsigned idle() const { return sleeping; }
+
+  // Queues a task from outside the pool, spreading tasks evenly over the workers' queues.
+  void submit(const task & t){
+    push(next, t);
+    next = (next+1) % queues.size();
+  }
+
+  // Queues a task from within a running task onto the queue of the given worker, where idle workers may steal it.
+  void spawn(unsigned worker, const task & t){ push(worker, t); }
+
+  // Blocks until every queued task has finished.
+  void wait(){
+    unique_lock<mutex> lock(idle_lock);
+    done.wait(lock, [this]{ return pending==0; });
+  }
+
+private:
+  struct task_queue{
+    mutex lock;
+    deque<task> tasks;
+  };
+
+  vector<thread> workers;
+  vector<task_queue> queues;                              //one queue per worker
+  atomic<unsigned long> queued;                           //number of tasks waiting in any queue
+  atomic<unsigned long> pending;                          //number of tasks queued or running
+  atomic<unsigned> sleeping;                              //number of workers waiting for tasks
+  unsigned next;                                          //queue for the next submitted task
+  bool stopping;                                          //set once the pool is destroyed
+  mutex idle_lock;                                        //guards sleeping and waking of workers and waiters
+  condition_variable wake;                                //signalled when tasks were queued
+  condition_variable done;                                //signalled when the last pending task finished
+
+  void push(unsigned worker, const task & t){
+    pending++;
+    {
+      lock_guard<mutex> guard(queues[worker].lock);
+      queues[worker].tasks.push_back(t);
+    }
+    queued++;
+    lock_guard<mutex> guard(idle_lock);                   //taking the lock ensures a worker about to sleep sees the new task
+    wake.notify_one();
+  }
+
+  bool take(unsigned worker, task & t){
+    for(unsigned k=0;k<queues.size();k++){                //own queue first, then the others
+      unsigned q = (worker+k) % queues.size();
+      lock_guard<mutex> guard(queues[q].lock);
+      deque<task> & tasks = queues[q].tasks;
+      if(tasks.empty()) continue;
+      if(!k){                                             //own queue: newest task, its data is most likely still in cache
+        t = tasks.back();
+        tasks.pop_back();
+      } else {                                            //stolen: oldest task, usually the largest piece of work
+        t = tasks.front();
+        tasks.pop_front();
+      }
+      queued--;
+      return true;
+    }
+    return false;
+  }
+
+  void run(unsigned worker){
+    task t;
+    for(;;){
+      if(take(worker, t)){
+        t(worker);
+        if(--pending==0){
+          lock_guard<mutex> guard(idle_lock);
+          done.notify_all();
+        }
+        continue;
+      }
+      unique_lock<mutex> lock(idle_lock);                 //nothing to do: sleep until tasks are queued or the pool is destroyed
+      sleeping++;
+      wake.wait(lock, [this]{ return queued>0 || stopping; });
+      sleeping--;
+      if(stopping && queued==0) return;
+    }
+  }
+};
 
-/* LOG OF OPTIMIZATION
-readings based on this worst-case sudoku and without any optimization flags:
-000000010000002003000400000000000500401600000007100000050000200000080040030910000
 
-0m51.620s	base reading
 
-1m10.074s	check order: box, col, row
+// ==============================================================================================================================================================================================================
+// BATCH MODE
+// ==============================================================================================================================================================================================================
 
-0m56.600s	check order: box, row, col
+const size_t batch_size = 65536;                          //puzzles read and solved before their results are written, bounds the memory needed for huge inputs
+const size_t max_chunk_size = 256;                        //puzzles per task at most, large enough to make the overhead of a task negligible
 
-0m53.362s	check order: row, col, box
+// Solves every puzzle of the stream on all workers of the pool and writes one line per puzzle in input order:
+// the cells of the solution (81 digits for 9x9), 'no solution', or 'invalid puzzle' for an incomplete block of the input. With 'count',
+// the line holds the number of solutions instead, counted up to the solution limit of the contexts. With 'stats', a JSON line with the totals and the time spent on
+// reading, solving and writing goes to stderr.
+template<int B> void run_batch(istream & in, ostream & out, const engine_entry<B> & engine, worker_pool & pool, vector<solver_context<B> > & contexts,
+                               bool count, bool stats){
+  typedef geometry<B> G;
+  vector<puzzle<B> > puzzles(batch_size);                 //current batch
+  vector<char> solved(batch_size);                        //result of every puzzle of the batch (char instead of bool, so that workers never share a byte)
+  vector<unsigned long long> counts(count ? batch_size : 0);  //solutions of every puzzle of the batch, only when counting
+  unsigned long long n_puzzles = 0, n_solved = 0, n_solutions = 0, n_invalid = 0;  //totals for the statistics
+  chrono::duration<double> parse_time(0), search_time(0), output_time(0);
+  puzzle_reader<B> reader(in);
 
-0m43.493s	move col, row_m and box calculations from function to main
-		//doing the same thing 9 times over at worst is indeed unnecessary
+  for(;;){
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    size_t n = 0;                                         //puzzles in this batch
+    while(n<batch_size && reader.read(puzzles[n])) n++;
+    chrono::steady_clock::time_point parsed = chrono::steady_clock::now();
+    parse_time += parsed - start;
+    if(!n) break;
 
-0m34.340s	reworked conditions for duplicate while loop and following if, save one additional loop over all conditions
-		//apparently, one additional loop = 1/4 extra time
+    size_t chunk_size = max<size_t>(1, min<size_t>(max_chunk_size, n/(4*pool.size())));  //smaller chunks for small batches, so that every worker gets several to steal
+    for(size_t first=0;first<n;first+=chunk_size){        //one task per chunk of puzzles
+      size_t last = min(first+chunk_size, n);
+      pool.submit([&, first, last](unsigned worker){
+        if(engine.solve_range) engine.solve_range(contexts[worker], &puzzles[first], &solved[first], last-first);  //all lanes busy with the chunk, incomplete puzzles are rare enough to be solved along
+        else for(size_t i=first;i<last;i++){
+          solved[i] = puzzles[i].complete && solve_puzzle(engine, contexts[worker], puzzles[i].grid);
+          if(count) counts[i] = solved[i] ? contexts[worker].solutions : 0;
+        }
+      });
+    }
+    pool.wait();
+    chrono::steady_clock::time_point searched = chrono::steady_clock::now();
+    search_time += searched - parsed;
 
-0m33.300s	define col, row_m and box as global variables to prevent overhead by passing variables
-		//interestingly does not change much
+    string line(G::cells+1, '\n');                        //all cells and a new line
+    for(size_t i=0;i<n;i++){                              //output of the results in input order
+      if(!puzzles[i].complete){
+        out << "invalid puzzle\n";
+        n_invalid++;
+      } else if(count){
+        out << counts[i] << '\n';
+        n_solved += solved[i];
+        n_solutions += counts[i];
+      } else if(solved[i]){
+        for(int c=0;c<G::cells;c++) line[c] = cell_char(puzzles[i].grid[c]);
+        out << line;
+        n_solved++;
+      } else out << "no solution\n";
+    }
+    n_puzzles += n;
+    out.flush();
+    output_time += chrono::steady_clock::now() - searched;
+  }
 
-0m32.536s	move relocation of rel_sudoku to if-cases, prevent extra assignment per loop
+  if(stats){
+    double total = (parse_time + search_time + output_time).count();
+    unsigned long long nodes = 0;
+    for(size_t w=0;w<contexts.size();w++) nodes += contexts[w].nodes;
+    cerr << "{\"puzzles\": " << n_puzzles << ", \"solved\": " << n_solved << ", \"invalid\": " << n_invalid << ", \"threads\": " << pool.size() << ", \"nodes\": " << nodes
+         << ", \"parse_ms\": " << parse_time.count()*1e3 << ", \"search_ms\": " << search_time.count()*1e3 << ", \"output_ms\": " << output_time.count()*1e3
+         << ", \"puzzles_per_s\": " << (total>0 ? n_puzzles/total : 0);
+    if(count) cerr << ", \"solutions\": " << n_solutions;
+#ifdef SUDOKU_STATS
+    search_stats all;
+    for(size_t w=0;w<contexts.size();w++) all.add(contexts[w].stats);
+    write_stats(cerr, all);
+#endif
+    cerr << "}\n";
+  }
+}
 
-0m30.394s	reworked evaluation of current cell to not test within array, instead uses global variable value
-		//not a big improvement
 
-0m26.683s	box-check: remove modulo operation and use if cases
-		//quite significant difference
 
-0m20.375s	row-check: use if cases instead of for-loop
-		//and someone said assignments were cheap
+// ==============================================================================================================================================================================================================
+// PARALLEL SEARCH
+// ==============================================================================================================================================================================================================
 
-0m16.750s	col-check: use if cases instead of for-loop
-		//well
+const unsigned subtrees_per_worker = 16;                  //subtrees handed out per worker at the start, enough for stealing to even out subtrees of very different size
+const int min_split_blanks = 24;                          //subtrees with fewer blanks left are searched right away, splitting them would cost more than it gains
 
-0m15.776s	move assignment of row, column and box pointers from function to main
-		//same thing performed at worst 9 times over is also unnecessary here
+template<int B> struct subtree{                           //grid with some of the first blanks filled in, the root of one part of the search tree
+  num grid[geometry<B>::cells];
+};
 
-0m12.853s	instead of comparing each new value of dowhile-loop to all row/column/box elements again, gather all existing values first and instead compare against that collection
-		//kind of self-evident
+// Fills the first blank (in grid order, like empty_cells of the backtracker) of the subtree with every value still allowed there
+// and appends the resulting subtrees to 'children'. Returns false if the grid has no blank left.
+template<int B> bool split(const subtree<B> & t, vector<subtree<B> > & children){
+  typedef geometry<B> G;
+  int cell = 0;                                           //offset of the first blank
+  while(cell<G::cells && t.grid[cell]) cell++;
+  if(cell==G::cells) return false;
+  int row = cell/G::size, col = cell%G::size, box = (row/B)*B*G::size + (col/B)*B;  //row, column and offset of the top left cell of the box
+  bool used[G::size+1] = {false};                         //values in use in the blank's row, column and box (used[0] collects the blanks)
+  for(int k=0;k<G::size;k++){
+    used[(int) t.grid[row*G::size+k]] = true;
+    used[(int) t.grid[k*G::size+col]] = true;
+    used[(int) t.grid[box+(k/B)*G::size+k%B]] = true;
+  }
+  for(num v=1;v<=G::size;v++){                            //one subtree per allowed value
+    if(used[(int) v]) continue;
+    children.push_back(t);
+    children.back().grid[cell] = v;
+  }
+  return true;
+}
 
-0m10.187s	row, column and box of each blank cell is now calculated upon reading the cell from file (this info obviously doesn't change), instead of each time anew upon consideration of a blank cell
-		//interesting how such a detail accounts for about 1/4 of computation time
+// Counts the blanks of a subtree.
+template<int B> int blanks_left(const subtree<B> & t){
+  int n = 0;
+  for(int c=0;c<geometry<B>::cells;c++) n += !t.grid[c];
+  return n;
+}
 
-0m8.986s	instead of collecting the existing values each time a new blank is considered, keep track of them for every row, column and box
-		//impact not as big as expected, introduced a lot of new assignments
+// Search of a single puzzle on all workers of a pool. The first blanks are branched on up front; every worker then searches whole
+// subtrees with the selected engine. While other workers are idle, a worker splits its subtree further before searching it, and the
+// engine hands out the untried branches of the search it is running, so that the idle workers can steal the parts.
+// All workers give up as soon as one of them has found a solution.
+template<int B> class tree_search{
+public:
+  tree_search(const engine_entry<B> & engine, worker_pool & pool, vector<solver_context<B> > & contexts) : engine(engine), pool(pool), contexts(contexts), found(false) {}
 
-0m8.190s	instead of pointing to two-dimensional arrays for storing existing values for each row, column and box, use one-dimensional arrays with offset
-		//that one exam exercise pays off
+  // Solves the grid in place. Returns false if there is no solution.
+  bool run(num * grid){
+    if(!engine.propagates && !presolve(contexts[0], grid)) return false;  //the pre-pass, if any, is done once before splitting
+    found = false;
+    vector<work_sharing<B> > sharing(contexts.size());    //one per worker, to queue the branches handed out on the worker's own queue
+    for(size_t w=0;w<contexts.size();w++){
+      sharing[w].wanted = [this]{ return pool.idle()>0; };
+      sharing[w].give = [this, w](const num * grid){
+        subtree<B> child;
+        copy(grid, grid+geometry<B>::cells, child.grid);
+        pool.spawn(w, [this, child](unsigned worker){ explore(worker, child); });
+      };
+      contexts[w].cancel = &found;
+      contexts[w].sharing = &sharing[w];
+    }
 
-0m7.636s	store row, column and box number as multiple of 12 to remove additional operations from while loop, data type changed to unsigned short int
+    //breadth-first branching on the first blanks until there are enough subtrees for all workers
+    vector<subtree<B> > frontier(1);
+    copy(grid, grid+geometry<B>::cells, frontier[0].grid);
+    while(!frontier.empty() && frontier.size()<subtrees_per_worker*pool.size()){
+      vector<subtree<B> > next;
+      bool any_split = false;
+      for(size_t i=0;i<frontier.size();i++){
+        if(split(frontier[i], next)) any_split = true;
+        else next.push_back(frontier[i]);                 //no blank left: keep the grid as it is, the engine only has to check it
+      }
+      frontier.swap(next);
+      if(!any_split) break;
+    }
 
-0m7.541s	instead of storing row, column and box information as well as empty cells as char, change data type to unsigned short int
-		//maybe prevents implicit casts to int upon use for offsets (?)
+    for(size_t i=0;i<frontier.size();i++){
+      const subtree<B> t = frontier[i];
+      pool.submit([this, t](unsigned worker){ explore(worker, t); });
+    }
+    pool.wait();
 
-0m7.326s	in output to terminal, use '\n' instead of endl to prevent the expensive emptying of the buffer
+    for(size_t w=0;w<contexts.size();w++){
+      contexts[w].cancel = 0;
+      contexts[w].sharing = 0;
+    }
+    if(found) copy(solution.grid, solution.grid+geometry<B>::cells, grid);
+    return found;
+  }
 
-0m7.013s	precalculate relative position of pointers to row, column and box outside of dowhile-loop to save three additions per loop iteration
+private:
+  const engine_entry<B> & engine;                         //engine to search the subtrees with
+  worker_pool & pool;
+  vector<solver_context<B> > & contexts;                  //one context per worker of the pool
+  atomic<bool> found;                                     //set by the first worker to find a solution, cancels all others
+  subtree<B> solution;                                    //written only by that worker
 
-0m6.782s	if a blank is succesfully filled, the next blank's value has to be 0. So it is unnecessary to read 0 from the array
-                //this fact was even described in that line's comment
+  void explore(unsigned worker, const subtree<B> & t){
+    if(found.load(memory_order_relaxed)) return;          //nothing left to do
+    if(pool.idle() && blanks_left(t)>=min_split_blanks){  //other workers have run out of work: hand out the parts of this subtree instead of searching it alone
+      vector<subtree<B> > children;
+      split(t, children);
+      for(size_t i=0;i<children.size();i++){
+        const subtree<B> child = children[i];
+        pool.spawn(worker, [this, child](unsigned w){ explore(w, child); });
+      }
+      return;
+    }
+    subtree<B> work = t;                                  //the engine fills the grid in place
+    if(engine.solve(contexts[worker], work.grid) && !found.exchange(true)) solution = work;
+  }
+};
+
+
+
+// ==============================================================================================================================================================================================================
+// GENERATOR
+// ==============================================================================================================================================================================================================
+
+// Fisher-Yates shuffle of n entries. Used instead of std::shuffle, whose sequence for a given generator differs between
+// standard libraries, so that a seed generates the same puzzles with every toolchain.
+template<class T> void shuffle_entries(mt19937_64 & rng, T * entries, int n){
+  for(int k=n-1;k>0;k--) swap(entries[k], entries[rng() % (k+1)]);
+}
+
+// Fills the grid with a random complete solution: the pattern grid ((r%B)*B + r/B + c) % size + 1, with its values, the rows
+// within every band, the bands, the columns within every stack and the stacks shuffled, and transposed half of the time. Each of
+// these transformations turns a valid grid into a valid grid.
+template<int B> void random_grid(mt19937_64 & rng, num * grid){
+  typedef geometry<B> G;
+  int bands[B], stacks[B], rows[G::size], cols[G::size];
+  num values[G::size+1];                                  //new value of every value of the pattern
+  for(int k=0;k<B;k++) bands[k] = stacks[k] = k;
+  for(int k=0;k<G::size;k++) rows[k] = cols[k] = k;
+  for(int v=0;v<=G::size;v++) values[v] = v;
+  shuffle_entries(rng, values+1, G::size);
+  shuffle_entries(rng, bands, B);
+  shuffle_entries(rng, stacks, B);
+  for(int k=0;k<B;k++){
+    shuffle_entries(rng, rows+k*B, B);
+    shuffle_entries(rng, cols+k*B, B);
+  }
+  bool transpose = rng() & 1;
+  for(int r=0;r<G::size;r++){
+    for(int c=0;c<G::size;c++){
+      int pr = rows[bands[r/B]*B + r%B], pc = cols[stacks[c/B]*B + c%B];  //row and column of the pattern grid
+      if(transpose) swap(pr, pc);
+      grid[r*G::size+c] = values[((pr%B)*B + pr/B + pc) % G::size + 1];
+    }
+  }
+}
+
+// Generates a puzzle with a unique solution into the grid: starting from a random complete grid, the clues are removed in random
+// order, every one for good unless the puzzle is left with more than one solution. The result is minimal, no clue can be removed
+// without losing uniqueness. Every removal is checked with the engine, on a context with the solution limit 2.
+template<int B> void generate(const engine_entry<B> & engine, solver_context<B> & ctx, mt19937_64 & rng, num * grid){
+  typedef geometry<B> G;
+  random_grid<B>(rng, grid);
+  int order[G::cells];                                    //order in which the clues are removed
+  for(int c=0;c<G::cells;c++) order[c] = c;
+  shuffle_entries(rng, order, G::cells);
+  num work[G::cells];                                     //the engine fills the grid in place
+  for(int k=0;k<G::cells;k++){
+    int c = order[k];
+    num clue = grid[c];
+    grid[c] = 0;
+    copy(grid, grid+G::cells, work);
+    if(!solve_puzzle(engine, ctx, work) || ctx.solutions!=1) grid[c] = clue;  //more than one solution: the clue stays
+  }
+}
+
+// Generates 'count' puzzles on all workers of the pool and writes them as one line of cells per puzzle ('0' for a blank), in batches
+// of batch_size. The puzzle with index i is generated from the seed sequence (seed, i) alone, so the output does not depend on the
+// number of threads. With 'stats', a JSON line with the totals and the rate of uniqueness checks goes to stderr.
+template<int B> void run_generator(ostream & out, const engine_entry<B> & engine, worker_pool & pool, vector<solver_context<B> > & contexts,
+                                   unsigned long long count, unsigned seed, bool stats){
+  typedef geometry<B> G;
+  vector<puzzle<B> > puzzles(min<unsigned long long>(count, batch_size));  //current batch
+  unsigned long long n_clues = 0;                         //totals for the statistics
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+  for(unsigned long long first=0;first<count;first+=batch_size){
+    size_t n = min<unsigned long long>(count-first, batch_size);  //puzzles in this batch
+    for(size_t i=0;i<n;i++){                              //one task per puzzle, each takes one search per cell
+      pool.submit([&, first, i](unsigned worker){
+        seed_seq sequence = {seed, (unsigned) (first+i)};
+        mt19937_64 rng(sequence);
+        generate(engine, contexts[worker], rng, puzzles[i].grid);
+      });
+    }
+    pool.wait();
+
+    string line(G::cells+1, '\n');                        //all cells and a new line
+    for(size_t i=0;i<n;i++){
+      for(int c=0;c<G::cells;c++){
+        line[c] = cell_char(puzzles[i].grid[c]);
+        n_clues += puzzles[i].grid[c]!=0;
+      }
+      out << line;
+    }
+    out.flush();
+  }
+
+  if(stats){
+    double total = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    unsigned long long nodes = 0, checks = count*G::cells;  //one uniqueness check per cell
+    for(size_t w=0;w<contexts.size();w++) nodes += contexts[w].nodes;
+    cerr << "{\"engine\": \"" << engine.name << "\", \"size\": " << G::size << ", \"puzzles\": " << count << ", \"threads\": " << pool.size()
+         << ", \"seed\": " << seed << ", \"clues\": " << (count ? (double) n_clues/count : 0) << ", \"checks\": " << checks << ", \"nodes\": " << nodes
+         << ", \"time_ms\": " << total*1e3 << ", \"puzzles_per_s\": " << (total>0 ? count/total : 0) << ", \"checks_per_s\": " << (total>0 ? checks/total : 0);
+#ifdef SUDOKU_STATS
+    search_stats all;
+    for(size_t w=0;w<contexts.size();w++) all.add(contexts[w].stats);
+    write_stats(cerr, all);
+#endif
+    cerr << "}\n";
+  }
+}
+
+
+
+// ==============================================================================================================================================================================================================
+// BENCHMARK
+// ==============================================================================================================================================================================================================
+
+// Every engine for grids with boxes of BxB cells, in the order the benchmark runs them.
+template<int B> vector<engine_entry<B> > all_engines(){
+  const engine_entry<B> scalar[] = {
+    {"backtrack", solve_backtrack<B>, false, 0, true},
+    {"bitmask", solve_bitmask<B>, false, 0, true},
+    {"propagate", solve_propagate<B>, true, 0, true},
+    {"dlx", solve_dlx<B>, false, 0, true},
+  };
+  vector<engine_entry<B> > engines(scalar, scalar + sizeof(scalar)/sizeof(scalar[0]));
+  add_simd_engine(engines);
+  return engines;
+}
+
+// Thread raising a flag once a deadline has passed. Serves as cancel flag of the benchmarked engine, so that a pathological
+// puzzle costs the benchmark a bounded amount of time instead of hours.
+class watchdog{
+public:
+  atomic<bool> expired;                                   //set once the armed deadline has passed
+
+  watchdog() : expired(false), armed(false), quit(false), timer(&watchdog::run, this) {}
+
+  ~watchdog(){
+    {
+      lock_guard<mutex> guard(lock);
+      quit = true;
+    }
+    wake.notify_one();
+    timer.join();
+  }
+
+  void arm(double seconds){
+    lock_guard<mutex> guard(lock);
+    expired = false;
+    deadline = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(seconds));
+    armed = true;
+    wake.notify_one();
+  }
+
+  void disarm(){
+    lock_guard<mutex> guard(lock);
+    armed = false;
+  }
+
+private:
+  mutex lock;
+  condition_variable wake;
+  chrono::steady_clock::time_point deadline;
+  bool armed, quit;
+  thread timer;
+
+  void run(){
+    unique_lock<mutex> guard(lock);
+    while(!quit){
+      if(!armed) wake.wait(guard);
+      else if(wake.wait_until(guard, deadline)==cv_status::timeout && armed && chrono::steady_clock::now()>=deadline){
+        expired = true;
+        armed = false;
+      }
+    }
+  }
+};
+
+// Value at the given fraction (0-1) of the sorted latencies, by nearest rank.
+double percentile(const vector<double> & sorted, double fraction){
+  if(sorted.empty()) return 0;
+  size_t rank = (size_t) (fraction*sorted.size() + 0.999999);
+  return sorted[rank ? rank-1 : 0];
+}
+
+// Writes a string as JSON string literal.
+void write_json_string(ostream & out, const string & s){
+  out << '"';
+  for(string::size_type i=0;i<s.size();i++){
+    if(s[i]=='"' || s[i]=='\\') out << '\\';
+    if((unsigned char) s[i]>=' ') out << s[i];            //control characters are dropped
+  }
+  out << '"';
+}
+
+// Runs every given engine single-threaded on every puzzle of the corpus, each puzzle 'repeats' times, and writes per-puzzle and
+// aggregate results as JSON: nodes and latency (the fastest of the repeats), and the detailed statistics if compiled in, per puzzle; latency percentiles, puzzles/s and nodes/s
+// per engine. Every engine gets an untimed warm-up run first. A puzzle running longer than 'timeout' seconds is cancelled and
+// reported as timed out and left out of the aggregate latencies and rates, which would otherwise depend on the timeout. For the SIMD engine, a pass
+// over the whole corpus with all lanes busy is timed in addition, as one puzzle at a time leaves all but one lane idle.
+template<int B> void run_benchmark(istream & in, ostream & out, const string & corpus, const vector<engine_entry<B> > & selected,
+                                   const solver_context<B> & settings, double timeout, int repeats){
+  typedef geometry<B> G;
+  vector<puzzle<B> > puzzles;                             //the whole corpus
+  puzzle<B> p;
+  puzzle_reader<B> reader(in);
+  while(reader.read(p)){
+    if(p.complete) puzzles.push_back(p);
+    else cerr << "incomplete puzzle at line " << p.line << " skipped\n";
+  }
+
+  out << "{\n  \"corpus\": ";
+  write_json_string(out, corpus);
+  out << ",\n  \"size\": " << G::size << ", \"puzzles\": " << puzzles.size() << ", \"propagation\": " << settings.propagation << ", \"repeats\": " << repeats
+      << ", \"timeout_s\": " << timeout << ", \"simd_lanes\": " << simd_lanes << ",\n  \"engines\": [";
+
+  watchdog dog;
+  for(size_t e=0;e<selected.size();e++){
+    solver_context<B> ctx = settings;
+    ctx.cancel = &dog.expired;
+    if(!puzzles.empty()){                                 //untimed warm-up on the first puzzle, sets up the matrix of the dlx engine and the buffers of the simd engine and fills the caches
+      puzzle<B> work = puzzles[0];
+      dog.arm(timeout);
+      solve_puzzle(selected[e], ctx, work.grid);
+      dog.disarm();
+      ctx.nodes = 0;
+    }
+    vector<double> latencies;                             //in microseconds, one per puzzle that did not time out
+    double total_us = 0;                                  //of the puzzles that did not time out
+    unsigned long long total_nodes = 0, n_solved = 0, n_timeouts = 0;
+
+    out << (e ? ",\n" : "\n") << "    {\"engine\": \"" << selected[e].name << "\", \"results\": [";
+    for(size_t i=0;i<puzzles.size();i++){
+      double best_us = 0;
+      unsigned long long nodes = 0;
+      bool solved = false, timed_out = false;
+      STATS(ctx.stats.clear(); search_stats puzzle_stats;)
+      for(int r=0;r<repeats && !timed_out;r++){           //a timed out puzzle is not repeated
+        puzzle<B> work = puzzles[i];
+        unsigned long long nodes_before = ctx.nodes;
+        dog.arm(timeout);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        solved = solve_puzzle(selected[e], ctx, work.grid);
+        chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+        dog.disarm();
+        timed_out = !solved && dog.expired;               //the deadline may pass between the end of a successful search and disarming
+        if(!r){
+          nodes = ctx.nodes - nodes_before;               //the search is deterministic, so every repeat takes the same nodes
+          STATS(puzzle_stats = ctx.stats;)
+          best_us = elapsed.count();
+        } else best_us = min(best_us, elapsed.count());
+      }
+      if(!timed_out){
+        latencies.push_back(best_us);
+        total_us += best_us;
+        total_nodes += nodes;
+      }
+      n_solved += solved;
+      n_timeouts += timed_out;
+
+      int clues = 0;
+      for(int c=0;c<G::cells;c++) clues += puzzles[i].grid[c]!=0;
+      out << (i ? ",\n" : "\n") << "      {\"title\": ";
+      write_json_string(out, puzzles[i].title);
+      out << ", \"clues\": " << clues << ", \"solved\": " << (solved ? "true" : "false") << ", \"timeout\": " << (timed_out ? "true" : "false")
+          << ", \"nodes\": " << nodes << ", \"time_us\": " << best_us;
+      STATS(write_stats(out, puzzle_stats);)
+      out << '}';
+    }
+
+    sort(latencies.begin(), latencies.end());
+    double total_s = total_us/1e6;
+    out << "\n    ], \"aggregate\": {\"solved\": " << n_solved << ", \"timeouts\": " << n_timeouts << ", \"nodes\": " << total_nodes
+        << ", \"total_ms\": " << total_us/1e3 << ", \"p50_us\": " << percentile(latencies, 0.5) << ", \"p90_us\": " << percentile(latencies, 0.9)
+        << ", \"p99_us\": " << percentile(latencies, 0.99) << ", \"max_us\": " << (latencies.empty() ? 0 : latencies.back())
+        << ", \"puzzles_per_s\": " << (total_s>0 ? latencies.size()/total_s : 0) << ", \"nodes_per_s\": " << (total_s>0 ? total_nodes/total_s : 0);
+
+    if(selected[e].solve_range && !puzzles.empty()){      //throughput with every lane busy
+      vector<puzzle<B> > work = puzzles;
+      vector<char> solved(work.size());
+      dog.arm(timeout*work.size());
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      selected[e].solve_range(ctx, &work[0], &solved[0], work.size());
+      chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+      dog.disarm();
+      out << ", \"batch_puzzles_per_s\": " << (elapsed.count()>0 ? work.size()/elapsed.count() : 0);
+    }
+    out << "}}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+
+
+// ==============================================================================================================================================================================================================
+// MAIN
+// ==============================================================================================================================================================================================================
+
+const char * usage = " [-n 4|9|16|25] [-e backtrack|bitmask|propagate|dlx|simd] [-l 0|1|2] [-b|-p|-B|-g count] [-c limit] [-a] [-S seed] [-j threads] [-r repeats] [-t seconds] [-s] [file|-]\n";
+
+struct command_line{                                      //settings given as arguments
+  string filename;                                        //input file, 'grid.dat' (or 'bench.dat' for the benchmark) unless given as argument, '-' for stdin
+  string engine;                                          //search engine, the original backtracking unless selected otherwise (every engine for the benchmark)
+  int size;                                               //rows, columns and values of the grid
+  int propagation;                                        //level of the deductions, none unless selected
+  bool batch;                                             //whether to solve every puzzle of the input instead of only the first
+  bool parallel;                                          //whether to split the search of a single puzzle over all worker threads
+  bool benchmark;                                         //whether to benchmark the engines on a corpus
+  int repeats;                                            //runs of every puzzle in the benchmark, the fastest counts
+  double timeout;                                         //seconds after which the benchmark gives up on a puzzle
+  unsigned n_threads;                                     //worker threads for batch mode, parallel search and the generator, one per core by default
+  bool stats;                                             //whether to print search statistics to stderr
+  bool count;                                             //whether to print the number of solutions instead of the solution
+  bool enumerate;                                         //whether to print every solution of the puzzle
+  unsigned long long limit;                               //solutions after which counting or enumeration stops, 0 for all
+  unsigned long long generate;                            //puzzles to generate instead of solving the input, none unless selected
+  unsigned seed;                                          //seed of the generator
+
+  command_line() : size(9), propagation(0), batch(false), parallel(false), benchmark(false), repeats(1), timeout(10),
+                   n_threads(thread::hardware_concurrency()), stats(false), count(false), enumerate(false), limit(0), generate(0), seed(1) {}
+};
+
+// Solves the input as selected on the command line, with the engines instantiated for boxes of BxB cells.
+template<int B> int run(const command_line & args, istream & input){
+  typedef geometry<B> G;
+  vector<engine_entry<B> > engines = all_engines<B>();
+  vector<engine_entry<B> > selected;
+  for(size_t e=0;e<engines.size();e++) if(args.engine.empty() ? !e || args.benchmark : args.engine==engines[e].name) selected.push_back(engines[e]);
+  if(selected.empty()){
+    cerr << "unknown engine '" << args.engine << "' for " << G::size << 'x' << G::size << " grids\n";
+    return 1;
+  }
+  if((args.count || args.enumerate || args.generate) && !selected[0].counts){
+    cerr << "engine '" << selected[0].name << "' cannot count solutions\n";
+    return 1;
+  }
+  solver_context<B> settings;                             //settings shared by all contexts
+  settings.propagation = args.propagation;
+  if(args.count || args.enumerate) settings.solution_limit = args.limit;
+  if(args.generate) settings.solution_limit = 2;          //enough to tell a unique solution from several
+
+  //generator
+  if(args.generate){
+    worker_pool pool(args.n_threads);
+    vector<solver_context<B> > contexts(args.n_threads, settings);  //one context per worker
+    run_generator(cout, selected[0], pool, contexts, args.generate, args.seed, args.stats);
+    return 0;
+  }
+
+  //benchmark
+  if(args.benchmark){
+    run_benchmark(input, cout, args.filename, selected, settings, args.timeout, args.repeats);
+    return 0;
+  }
+
+  //batch mode
+  if(args.batch){
+    worker_pool pool(args.n_threads);
+    vector<solver_context<B> > contexts(args.n_threads, settings);  //one context per worker
+    run_batch(input, cout, selected[0], pool, contexts, args.count, args.stats);
+    return 0;
+  }
+
+  //single puzzle
+  vector<solver_context<B> > contexts(args.parallel ? args.n_threads : 1, settings);  //one context per worker, or a single one for the sequential search
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  puzzle<B> p;
+  puzzle_reader<B> reader(input);
+  for(;;){                                                //the first complete puzzle of the input
+    if(!reader.read(p)){
+      cerr << "no sudoku found in input\n";
+      return 1;
+    }
+    if(p.complete) break;
+    cerr << "incomplete puzzle at line " << p.line << " skipped\n";
+  }
+  string line(G::cells+1, '\n');                          //all cells and a new line, for every solution enumerated
+  function<void(const num *)> print_solution = [&line](const num * grid){
+    for(int c=0;c<G::cells;c++) line[c] = cell_char(grid[c]);
+    cout << line;
+  };
+  if(args.enumerate) contexts[0].on_solution = &print_solution;
+  chrono::steady_clock::time_point parsed = chrono::steady_clock::now();
+  bool solved;
+  if(args.parallel){
+    worker_pool pool(args.n_threads);
+    tree_search<B> search(selected[0], pool, contexts);
+    solved = search.run(p.grid);
+  } else solved = solve_puzzle(selected[0], contexts[0], p.grid);
+  chrono::steady_clock::time_point searched = chrono::steady_clock::now();
+
+  //Output of solution
+  if(args.count && !args.enumerate) cout << (solved ? contexts[0].solutions : 0) << '\n';  //with -a, -c only limits the solutions printed
+  else if(solved && !args.enumerate){
+    for(int i=0;i<G::cells;i++){                          //for all elements of the sudoku
+      if(!(i%G::size)) cout << '\n';                      //insert a new line if new row is reached
+      cout << cell_char(p.grid[i]);                       //print value of the grid at position i
+    }
+    cout << '\n';
+    cout.flush();                                         //part of the output time
+  }
+  chrono::steady_clock::time_point written = chrono::steady_clock::now();
+
+  //statistics as one JSON line
+  if(args.stats){
+    unsigned long long nodes = 0;
+    for(size_t w=0;w<contexts.size();w++) nodes += contexts[w].nodes;
+    cerr << "{\"engine\": \"" << selected[0].name << "\", \"size\": " << G::size << ", \"threads\": " << contexts.size() << ", \"solved\": " << (solved ? "true" : "false")
+         << ", \"nodes\": " << nodes << ", \"parse_us\": " << chrono::duration<double, micro>(parsed - start).count()
+         << ", \"search_us\": " << chrono::duration<double, micro>(searched - parsed).count()
+         << ", \"output_us\": " << chrono::duration<double, micro>(written - searched).count();
+    if(args.count || args.enumerate) cerr << ", \"solutions\": " << (solved ? contexts[0].solutions : 0);
+#ifdef SUDOKU_STATS
+    search_stats all;
+    for(size_t w=0;w<contexts.size();w++) all.add(contexts[w].stats);
+    write_stats(cerr, all);
+#endif
+    cerr << "}\n";
+  }
+  if(!solved){
+    cerr << "no solution\n";
+    return 1;
+  }
+
+  return 0;
+}
+
+int main(int argc, char ** argv){
+  ios::sync_with_stdio(false);                            //no mixing with C stdio, allows faster streaming of large inputs
+
+  //command line arguments
+  command_line args;
+  for(int a=1;a<argc;a++){
+    string arg = argv[a];
+    if(arg=="-e" && a+1<argc) args.engine = argv[++a];
+    else if(arg=="-n" && a+1<argc) args.size = atoi(argv[++a]);
+    else if(arg=="-l" && a+1<argc) args.propagation = atoi(argv[++a]);
+    else if(arg=="-b") args.batch = true;
+    else if(arg=="-p") args.parallel = true;
+    else if(arg=="-B") args.benchmark = true;
+    else if(arg=="-r" && a+1<argc) args.repeats = atoi(argv[++a]);
+    else if(arg=="-t" && a+1<argc) args.timeout = atof(argv[++a]);
+    else if(arg=="-j" && a+1<argc) args.n_threads = atoi(argv[++a]);
+    else if(arg=="-s") args.stats = true;
+    else if(arg=="-c" && a+1<argc){
+      args.count = true;
+      args.limit = strtoull(argv[++a], 0, 10);
+    }
+    else if(arg=="-a") args.enumerate = true;
+    else if(arg=="-g" && a+1<argc) args.generate = strtoull(argv[++a], 0, 10);
+    else if(arg=="-S" && a+1<argc) args.seed = strtoul(argv[++a], 0, 10);
+    else if(arg=="-" || arg[0]!='-') args.filename = arg;
+    else {
+      cerr << "usage: " << argv[0] << usage;
+      return 1;
+    }
+  }
+  if(args.filename.empty()) args.filename = args.benchmark ? "bench.dat" : "grid.dat";
+  if(args.generate && args.engine.empty()) args.engine = args.size>9 ? "propagate" : "bitmask";  //the fastest uniqueness checks, the puzzles are the same with every engine
+  if(args.repeats<1) args.repeats = 1;
+  if(!args.n_threads) args.n_threads = 1;                 //hardware_concurrency() may not know the number of cores
+  if(args.propagation<0 || args.propagation>2){
+    cerr << "unknown propagation level " << args.propagation << '\n';
+    return 1;
+  }
+  if((args.count || args.enumerate || args.generate) && (args.parallel || args.benchmark)){
+    cerr << "-c, -a and -g cannot be combined with -p or -B\n";
+    return 1;
+  }
+  if((args.enumerate && args.batch) || (args.generate && (args.batch || args.count || args.enumerate))){
+    cerr << "-a enumerates the solutions of a single puzzle, -g takes no input\n";
+    return 1;
+  }
+
+  ifstream data;                                          //with fstream
+  if(args.filename!="-" && !args.generate){               //the generator reads no input
+    data.open(args.filename.c_str());                     //open the input file, 'grid.dat' in the same directory unless given as argument
+    if(!data){                                            //without input there is nothing to solve
+      cerr << "cannot open input file '" << args.filename << "'\n";
+      return 1;
+    }
+  }
+  istream & input = args.filename=="-" ? cin : data;
+
+  switch(args.size){                                      //one instantiation of the solver per box size
+    case 4: return run<2>(args, input);
+    case 9: return run<3>(args, input);
+    case 16: return run<4>(args, input);
+    case 25: return run<5>(args, input);
+  }
+  cerr << "unsupported grid size " << args.size << " (4, 9, 16 or 25)\n";
+  return 1;
+}
 
-0m6.499s	reworked conditions of dowhile loop once more; saves one loop if terminating due to not finding a possible value to fill in
 
-0m6.213s	reworked logic for evaluation of duplicates. By use of AND instead of OR, short-circuit property prevents further evaluation if number is already used in a previous test case
+/* BENCHMARKS
+The hand-timed log of optimizations that used to be kept here (single puzzle, no optimization flags, last reading 0m6.116s) is
+replaced by the benchmark mode. It runs every engine on the checked-in corpus 'bench.dat', which includes the worst-case grid of
+that log as 'worst-case', and writes per-puzzle and aggregate latencies as JSON:
 
-0m6.192s	arrays containing the existence information of numbers for every row, column and box are now type bool
+  g++ -O2 -march=native -pthread sudoku_solver.cc -o sudoku_solver
+  ./sudoku_solver -B -r 3 > bench.json
 
-0m6.116s	invert pointer update ifclause to prevent additional negation
+Keep the JSON of a build and compare the aggregates of later builds against it to catch performance regressions.
 */